@@ -0,0 +1,75 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionAsyncJob.h"
+#include "TargetSelectionDistance.h"
+#include "TargetSelectionStats.h"
+#include "GameFramework/Actor.h"
+
+DECLARE_CYCLE_STAT(TEXT("AsyncJob Run"), STAT_TargetSelection_AsyncJobRun, STATGROUP_TargetSelection);
+
+FTargetSelectionAsyncJob::FTargetSelectionAsyncJob()
+	: OwnerLocation(FVector::ZeroVector)
+	, bIsSortByDistance(false)
+	, WatchSequence(0)
+	, bIsDone(false)
+	, bIsCancelled(false)
+{
+}
+
+void FTargetSelectionAsyncJob::AddCandidate(AActor* Candidate, const FVector& Location)
+{
+	Candidates.Add(Candidate);
+	Classes.Add(Candidate->GetClass());
+	LocationsX.Add(Location.X);
+	LocationsY.Add(Location.Y);
+	LocationsZ.Add(Location.Z);
+}
+
+void FTargetSelectionAsyncJob::Run()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_AsyncJobRun);
+
+	/*Filter the candidates by the classes.*/
+	TArray<int32> PassedIndices;
+	PassedIndices.Reserve(Candidates.Num());
+	for (int32 Index = 0; Index != Candidates.Num(); Index++)
+	{
+		if (bIsCancelled)
+		{
+			return;
+		}
+		if (Filter.CheckClass(Classes[Index]))
+		{
+			PassedIndices.Add(Index);
+		}
+	}
+
+	/*Sort the passed candidates by the squared distances, as SortActorsByDistance() does.*/
+	if (bIsSortByDistance && PassedIndices.Num() > 1 && !bIsCancelled)
+	{
+		TArray<float> DistanceKeys;
+		DistanceKeys.SetNumUninitialized(Candidates.Num());
+		TargetSelectionDistance::ComputeDistancesSquared(
+			LocationsX.GetData(),
+			LocationsY.GetData(),
+			LocationsZ.GetData(),
+			Candidates.Num(),
+			OwnerLocation,
+			DistanceKeys.GetData()
+		);
+
+		PassedIndices.Sort([&DistanceKeys](int32 A, int32 B)
+		{
+			return DistanceKeys[A] < DistanceKeys[B] || (DistanceKeys[A] == DistanceKeys[B] && A < B);
+		});
+	}
+
+	Result.Reserve(PassedIndices.Num());
+	for (int32 PassedIndex : PassedIndices)
+	{
+		Result.Add(Candidates[PassedIndex]);
+	}
+
+	bIsDone = true;
+}
@@ -0,0 +1,57 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+#include "TargetSelectionFilterProfile.h"
+
+class AActor;
+
+/*
+Filtering and sorting of the candidates on the task graph.
+The job works with the snapshot of the candidates taken on the game thread and never touches the actors themselves.
+*/
+struct FTargetSelectionAsyncJob
+{
+	/*Snapshot. The candidates.*/
+	TArray<TWeakObjectPtr<AActor>> Candidates;
+
+	/*Snapshot. Classes of the candidates.*/
+	TArray<UClass*> Classes;
+
+	/*Snapshot. Locations of the candidates as a structure of arrays.*/
+	TArray<float> LocationsX;
+	TArray<float> LocationsY;
+	TArray<float> LocationsZ;
+
+	/*Snapshot. Location of the owner.*/
+	FVector OwnerLocation;
+
+	/*Snapshot. Copy of the current filters.*/
+	FTargetSelectionCompiledFilter Filter;
+
+	/*Do you want to sort the result by the distance to the owner?*/
+	bool bIsSortByDistance;
+
+	/*Number of the watch request the job was started for. The result of a forgotten request is dropped.*/
+	uint32 WatchSequence;
+
+	/*Result. The candidates that passed the filters, sorted if allowed.*/
+	TArray<TWeakObjectPtr<AActor>> Result;
+
+	/*Is the result ready?*/
+	FThreadSafeBool bIsDone;
+
+	/*Is the result not needed anymore?*/
+	FThreadSafeBool bIsCancelled;
+
+	FTargetSelectionAsyncJob();
+
+	/*Add the candidate with its location to the snapshot.*/
+	void AddCandidate(AActor* Candidate, const FVector& Location);
+
+	/*Filter and sort the snapshot. Called on a worker thread.*/
+	void Run();
+};
@@ -3,16 +3,62 @@
 
 #include "TargetSelectionComponent.h"
 #include "TargetSelectionInterface.h"
+#include "TargetSelectionDistance.h"
+#include "TargetSelectionFilterProfile.h"
+#include "TargetSelectionAsyncJob.h"
+#include "TargetSelectionSubsystem.h"
+#include "TargetSelectionStats.h"
+#include "TargetSelectionCore.h"
 #include "Containers/Array.h"
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
 #include "Components/SphereComponent.h"
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "GameFramework/PlayerController.h"
+#include "WorldCollision.h"
+#include "Net/UnrealNetwork.h"
 #include "Kismet/KismetMathLibrary.h"
-#include "Kismet/KismetSystemLibrary.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+DECLARE_CYCLE_STAT(TEXT("GetAvailableActors"), STAT_TargetSelection_GetAvailableActors, STATGROUP_TargetSelection);
+DECLARE_CYCLE_STAT(TEXT("SortActorByFilters"), STAT_TargetSelection_SortActorByFilters, STATGROUP_TargetSelection);
+DECLARE_CYCLE_STAT(TEXT("FilterActorsInParallel"), STAT_TargetSelection_FilterActorsInParallel, STATGROUP_TargetSelection);
+DECLARE_CYCLE_STAT(TEXT("SortActorsByDistance"), STAT_TargetSelection_SortActorsByDistance, STATGROUP_TargetSelection);
+DECLARE_CYCLE_STAT(TEXT("CallInterfaceIsObserved"), STAT_TargetSelection_CallInterfaceIsObserved, STATGROUP_TargetSelection);
+DECLARE_CYCLE_STAT(TEXT("UpdateAutoTargeting"), STAT_TargetSelection_UpdateAutoTargeting, STATGROUP_TargetSelection);
+DECLARE_CYCLE_STAT(TEXT("CallInterfaceIsNotObserved"), STAT_TargetSelection_CallInterfaceIsNotObserved, STATGROUP_TargetSelection);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Candidates scanned"), STAT_TargetSelection_NumCandidatesScanned, STATGROUP_TargetSelection);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Candidates passed filters"), STAT_TargetSelection_NumCandidatesFiltered, STATGROUP_TargetSelection);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Actors sorted"), STAT_TargetSelection_NumActorsSorted, STATGROUP_TargetSelection);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sorts skipped"), STAT_TargetSelection_NumSortsSkipped, STATGROUP_TargetSelection);
+
+CSV_DEFINE_CATEGORY(TargetSelection, true);
+
+namespace
+{
+	/*The smallest number of actors handled by one worker.*/
+	const int32 MinParallelChunkSize = 256;
+
+	/*Split Num items into chunks, one per worker thread at most.*/
+	int32 GetNumParallelChunks(int32 Num)
+	{
+		const int32 MaxChunks = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+		return FMath::Clamp(FMath::DivideAndRoundUp(Num, MinParallelChunkSize), 1, MaxChunks);
+	}
 
+	float GetDistanceSquared(const FVector& A, const FVector& B)
+	{
+		return FVector::DistSquared(A, B);
+	}
+}
 
 // Sets default values for this component's properties
 UTargetSelectionComponent::UTargetSelectionComponent()
 {
-	PrimaryComponentTick.bCanEverTick = false;
+	/*The component ticks only while the result of the async job is waited for or while the line of sight of the observed actors is checked.*/
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
 
 	/*Create and set up a collision*/
 	TargetSelectionCollision = CreateDefaultSubobject<USphereComponent>(TEXT("TargetSelectionCollision"));
@@ -35,19 +81,59 @@ UTargetSelectionComponent::UTargetSelectionComponent()
 	bIsSortArrayOfActors_WhenSwitch = false;
 	bIsSortArrayOfActors_WhenRemove = false;
 	bIsSortArrayOfActors_WhenAddNew = false;
+	bIsInsertNewActorsInOrder = false;
+	NumberOfNearestActorsToOrder = 0;
+	SortMovementThreshold = 0.f;
+	OwnerLocationCache = FVector::ZeroVector;
+	ActorLocationsCacheFrame = MAX_uint64;
+
+	bIsCheckLineOfSight = false;
+	LineOfSightChannel = ECC_Visibility;
+	LineOfSightCacheLifetime = 0.5f;
+	MaxLineOfSightTracesPerFrame = 16;
+	bIsRecentlyRenderedVisible = false;
+	NumLineOfSightTraces = 0;
+	LineOfSightTraceFrame = 0;
+
+	bIsReplicateSelection = false;
+	bIsAcceptSwitchRequests = false;
+	MaxReplicatedCandidates = 8;
+
+	bIsAutoTargeting = false;
+	bIsAutoTargetingIdle = false;
+	AutoTargetingInterval = 0.2f;
+	AutoTargetingMaxInterval = 2.f;
+	AutoTargetingSignificanceDistance = 5000.f;
+	AutoTargetingOffScreenSignificance = 0.5f;
+	NextAutoTargetingTime = 0.f;
+	NumSkippedSorts = 0;
+	NumPerformedSorts = 0;
 	bIsWatchingNow = false;
 	bIsDebugMode = false;
 	bIsShowCollision = false;
 
 	bIsCheckAddingActorsForDuplicates = false;
 
-	IndexOfCurrentObservedActor = 0;
+	bIsUseSpatialGrid = false;
+	bIsUseTargetableChannel = false;
+	TargetableChannel = ECC_Pawn;
+	SelectorChannel = ECC_WorldDynamic;
+	bIsUpdateActorsByOverlaps = false;
+	bIsUseOverlapQuery = false;
+	OverlapQueryRadius = 1000.f;
+	bIsOverlapQueryPending = false;
+	OverlapQuerySequence = 0;
+
+	ParallelProcessingThreshold = 2048;
+	bIsUseAsyncWatching = false;
+	AsyncWatchSequence = 0;
 
 	bIsValidClassesFilter = false;
 	bIsValidClassesFilterException = false;
 	bIsValidInterfaceFilter = false;
 
 	bIsCustomArray = false;
+	CurrentFilterProfile = nullptr;
 
 
 	bIsSwitchToFirstActor_WhenRemoveObservedActor = true;
@@ -55,29 +141,162 @@ UTargetSelectionComponent::UTargetSelectionComponent()
 }
 
 
+// Called after the properties and the collision are initialized
+void UTargetSelectionComponent::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	/*The collision is changed before it is registered, so it never gets the physics state it doesn't need.
+	The queries don't use it at all, the registry uses only its radius.*/
+	if (TargetSelectionCollision != nullptr && (bIsUseOverlapQuery || bIsUseSpatialGrid))
+	{
+		TargetSelectionCollision->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		if (bIsUseOverlapQuery)
+		{
+			TargetSelectionCollision->bAutoRegister = false;
+		}
+	}
+}
+
 // Called when the game starts
 void UTargetSelectionComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
-	/*If the owner of the component is valid, then attach the collision to the owner.
-	It is done again in case the owner is not valid in the constructor.
-	*/
+	/*Take the owner again in case it is not valid in the constructor.*/
 	if (GetOwner() != nullptr)
 	{
 		Owner = GetOwner();
-		if (!TargetSelectionCollision->IsAttachedTo(Owner->GetRootComponent()))
+	}
+
+	/*Only the changes of the selection of the server are sent. The requests of the clients need the replicated component too.*/
+	if (bIsReplicateSelection || bIsAcceptSwitchRequests)
+	{
+		SetIsReplicated(true);
+	}
+
+	if (bIsAutoTargeting)
+	{
+		if (UTargetSelectionSubsystem* TargetSelectionSubsystem = GetTargetSelectionSubsystem())
 		{
-			TargetSelectionCollision->SetupAttachment(Owner->GetRootComponent());
+			TargetSelectionSubsystem->RegisterAutoTargetingComponent(this);
 		}
 	}
 
+	/*The actors are found by the queries, the collision is not needed.*/
+	if (bIsUseOverlapQuery && TargetSelectionCollision != nullptr)
+	{
+		TargetSelectionCollision->DestroyComponent();
+		TargetSelectionCollision = nullptr;
+	}
+
+	if (TargetSelectionCollision == nullptr)
+	{
+		return;
+	}
+
+	/*If the owner of the component is valid, then attach the collision to the owner.*/
+	if (Owner != nullptr && !TargetSelectionCollision->IsAttachedTo(Owner->GetRootComponent()))
+	{
+		TargetSelectionCollision->SetupAttachment(Owner->GetRootComponent());
+	}
+
 	if (bIsShowCollision)
 	{
 		/*Show collision in the game.*/
 		TargetSelectionCollision->SetHiddenInGame(false);
 	}
 
+	/*The registry is queried instead of the overlaps, only the radius of the collision is used.*/
+	if (bIsUseSpatialGrid)
+	{
+		TargetSelectionCollision->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	}
+	else
+	{
+		/*Overlap the targets only.*/
+		if (bIsUseTargetableChannel)
+		{
+			if (bIsDebugMode && SelectorChannel == TargetableChannel)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("TargetSelection: BeginPlay(): SelectorChannel is the same as TargetableChannel, the collisions of the other selectors are overlapped."));
+			}
+			TargetSelectionCollision->SetCollisionObjectType(SelectorChannel);
+			TargetSelectionCollision->SetCollisionResponseToAllChannels(ECR_Ignore);
+			TargetSelectionCollision->SetCollisionResponseToChannel(TargetableChannel, ECR_Overlap);
+		}
+
+		/*Keep the candidates by the overlap events, beginning with the actors already in the collision.*/
+		if (bIsUpdateActorsByOverlaps)
+		{
+			TargetSelectionCollision->OnComponentBeginOverlap.AddDynamic(this, &UTargetSelectionComponent::OnTargetSelectionBeginOverlap);
+			TargetSelectionCollision->OnComponentEndOverlap.AddDynamic(this, &UTargetSelectionComponent::OnTargetSelectionEndOverlap);
+
+			CandidateActorsBuffer.Reset();
+			TargetSelectionCollision->GetOverlappingActors(CandidateActorsBuffer);
+			OverlappedCandidates.Append(CandidateActorsBuffer);
+			OverlappedCandidates.Remove(Owner);
+		}
+	}
+
+}
+
+// Called when the game ends
+void UTargetSelectionComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	CancelAsyncWatching();
+
+	if (bIsUpdateActorsByOverlaps && TargetSelectionCollision != nullptr)
+	{
+		TargetSelectionCollision->OnComponentBeginOverlap.RemoveDynamic(this, &UTargetSelectionComponent::OnTargetSelectionBeginOverlap);
+		TargetSelectionCollision->OnComponentEndOverlap.RemoveDynamic(this, &UTargetSelectionComponent::OnTargetSelectionEndOverlap);
+		OverlappedCandidates.Empty();
+	}
+	OverlapQueryActors.Empty();
+
+	if (bIsAutoTargeting)
+	{
+		if (UTargetSelectionSubsystem* TargetSelectionSubsystem = GetTargetSelectionSubsystem())
+		{
+			TargetSelectionSubsystem->UnregisterAutoTargetingComponent(this);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UTargetSelectionComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UTargetSelectionComponent, ReplicatedState);
+	DOREPLIFETIME(UTargetSelectionComponent, ReplicatedCandidates);
+}
+
+void UTargetSelectionComponent::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+	UTargetSelectionComponent* This = CastChecked<UTargetSelectionComponent>(InThis);
+
+	/*The destroyed actors are cleared as in a property.*/
+	This->SelectionCore.ForEachHandleReference([This, &Collector](AActor*& Actor)
+	{
+		Collector.AddReferencedObject(Actor, This);
+	});
+
+	Super::AddReferencedObjects(InThis, Collector);
+}
+
+void UTargetSelectionComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	/*Wait for the job until it is done.*/
+	if (PendingAsyncJob.IsValid() && PendingAsyncJob->bIsDone)
+	{
+		ApplyAsyncWatching();
+	}
+
+	UpdateLineOfSight();
 }
 
 void UTargetSelectionComponent::WatchActors(
@@ -112,6 +331,10 @@ void UTargetSelectionComponent::WatchActors(
 		/*Remember the key in the temporary variable.*/
 		CurrentInputKey = InputKey;
 
+		/*The filters are changed, forget the checked classes.*/
+		ClassFilterVerdicts.Reset();
+		CurrentFilterProfile = nullptr;
+
 		FString LogNotValidClass = "TargetSelection: Class in ClassesFilter is not valid, the Actor is used by default. (IsPendingKill or nullptr): ";
 		FString LogEmptyArray = "TargetSelection: ClassesFilter is empty. The Actor is used by default.";
 		CheckInputData_Classes(
@@ -137,25 +360,15 @@ void UTargetSelectionComponent::WatchActors(
 	}
 
 	/*If the array of observed actors is not empty.*/
-	if (ObservedActorsArr.Num() > 0)
+	if (SelectionCore.Num() > 0)
 	{
 		SwitchCurrentActors();
 	}
 	/*If the array is empty.
-	ObservedActorsArr.Num() == 0.*/
+	SelectionCore.Num() == 0.*/
 	else
 	{
-		/*Take actors to the array ObservedActorsArr.
-		If the array is not empty, continue.*/
-		if (GetAvailableActors())
-		{
-			/*Sort the array if allowed.*/
-			if (bIsSortArrayOfActors_WhenBegin)
-			{
-				SortActorsByDistance();
-			}
-			SwitchToNewActor();
-		}
+		StartWatching();
 	}
 }
 
@@ -185,32 +398,27 @@ void UTargetSelectionComponent::WatchActors_OneFilter_Interface(TSubclassOf<UInt
 		/*Remember the key in the temporary variable.*/
 		CurrentInputKey = InputKey;
 
+		/*The filters are changed, forget the checked classes.*/
+		ClassFilterVerdicts.Reset();
+		CurrentFilterProfile = nullptr;
+
 		CheckInputData_Interface(InterfaceFilter);
 
 	}
 
 	/*If the array of observed actors is not empty.*/
-	if (ObservedActorsArr.Num() > 0)
+	if (SelectionCore.Num() > 0)
 	{
 		SwitchCurrentActors();
 	}
 	/*If the array is empty.
-	ObservedActorsArr.Num() == 0.*/
+	SelectionCore.Num() == 0.*/
 	else
 	{
 		bIsValidClassesFilter = false;
 		bIsValidClassesFilterException = false;
-		/*Take actors to the array ObservedActorsArr.
-		If the array is not empty, continue.*/
-		if (GetAvailableActors())
-		{
-			/*Sort the array if allowed.*/
-			if (bIsSortArrayOfActors_WhenBegin)
-			{
-				SortActorsByDistance();
-			}
-			SwitchToNewActor();
-		}
+		ClassFilterVerdicts.Reset();
+		StartWatching();
 	}
 }
 
@@ -219,7 +427,24 @@ void UTargetSelectionComponent::WatchActors_CustomArray(
 	FKey InputKey
 )
 {
+	if (PrepareCustomArrayWatching(CustomArray, InputKey))
+	{
+		SelectionCore.Assign(CustomArray);
+		StartCustomArrayWatching();
+	}
+}
+
+void UTargetSelectionComponent::WatchActors_CustomArray(TArray<AActor*>&& CustomArray, FKey InputKey)
+{
+	if (PrepareCustomArrayWatching(CustomArray, InputKey))
+	{
+		SelectionCore.Assign(MoveTemp(CustomArray));
+		StartCustomArrayWatching();
+	}
+}
 
+bool UTargetSelectionComponent::PrepareCustomArrayWatching(const TArray<AActor*>& CustomArray, FKey InputKey)
+{
 	if (CustomArray.Num() == 0)
 	{
 		if (bIsDebugMode)
@@ -227,7 +452,7 @@ void UTargetSelectionComponent::WatchActors_CustomArray(
 			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: CustomArray is empty."))
 		}
 
-		return;
+		return false;
 	}
 
 	for (int32 Index = 0; Index != CustomArray.Num(); Index++)
@@ -238,7 +463,7 @@ void UTargetSelectionComponent::WatchActors_CustomArray(
 			{
 				UE_LOG(LogTemp, Warning, TEXT("TargetSelection: WatchActors_CustomArray(): Actor at Index %d in CustomArray is not valid."), Index);
 			}
-			return;
+			return false;
 		}
 	}
 
@@ -248,7 +473,7 @@ void UTargetSelectionComponent::WatchActors_CustomArray(
 	/*If the entrance isn't valid.*/
 	if (StateOfCheckInputKey == 0)
 	{
-		return;
+		return false;
 	}
 
 	bIsCustomArray = true;
@@ -266,37 +491,109 @@ void UTargetSelectionComponent::WatchActors_CustomArray(
 		/*Remember the key in the temporary variable.*/
 		CurrentInputKey = InputKey;
 
+		CurrentFilterProfile = nullptr;
+
 	}
 
 	/*If the array of observed actors is not empty.*/
-	if (ObservedActorsArr.Num() > 0)
+	if (SelectionCore.Num() > 0)
 	{
 		/*Switch the current actors.*/
 		SwitchCurrentActors();
+		return false;
 	}
 
-	/*If the array is empty.
-	ObservedActorsArr.Num() == 0.*/
-	else
+	/*If the array is empty, the observation begins with the outside array.*/
+	return true;
+}
+
+void UTargetSelectionComponent::StartCustomArrayWatching()
+{
+	/*The candidates of the job running for the previous request are not merged into the outside array.*/
+	CancelAsyncWatching();
+
+	/*Save the actors of the array.*/
+	CustomArrayDuplicate.Reset();
+	CustomArrayDuplicate.Append(SelectionCore.GetHandles());
+
+	/*The locations of the new array are not read yet.*/
+	ActorLocationsCacheFrame = MAX_uint64;
+
+	/*Sort the array if allowed.*/
+	if (bIsSortArrayOfActors_WhenBegin)
 	{
-		/*Save the array*/
-		CustomArrayDuplicate = CustomArray;
+		SortActorsByDistance();
+	}
 
-		ObservedActorsArr = CustomArray;
+	/*Turn on the observation, switch to the first actor.*/
+	SwitchToNewActor();
+}
 
-		/*Sort the array if allowed.*/
-		if (bIsSortArrayOfActors_WhenBegin)
+void UTargetSelectionComponent::WatchActors_FilterProfile(UTargetSelectionFilterProfile* FilterProfile, FKey InputKey)
+{
+	if (FilterProfile == nullptr)
+	{
+		if (bIsDebugMode)
 		{
-			SortActorsByDistance();
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: WatchActors_FilterProfile(): FilterProfile is not valid."));
 		}
+		return;
+	}
 
-		/*Turn on the observation, switch to the first actor.*/
-		SwitchToNewActor();
+	/*Check the input key.*/
+	uint32 StateOfCheckInputKey = CheckInputData_InputKey(InputKey);
+
+	/*If the input isn't valid.*/
+	if (StateOfCheckInputKey == 0)
+	{
+		return;
+	}
+
+	bIsCustomArray = false;
+
+	/*If the input key is not equal to the temporary key, take the profile. It is checked and compiled already.*/
+	if (StateOfCheckInputKey == 2)
+	{
+		if (bIsDebugMode)
+		{
+			UE_LOG(LogTemp, Display, TEXT("TargetSelection: New key %s, profile %s"), *InputKey.GetFName().ToString(), *FilterProfile->GetName());
+		}
+
+		/*Disable observation.*/
+		OffWatchingActors();
+
+		/*Remember the key in the temporary variable.*/
+		CurrentInputKey = InputKey;
+
+		/*The verdicts of the profile are kept in the profile itself.*/
+		ClassFilterVerdicts.Reset();
+		CurrentFilterProfile = FilterProfile;
+	}
+
+	/*If the array of observed actors is not empty.*/
+	if (SelectionCore.Num() > 0)
+	{
+		SwitchCurrentActors();
+	}
+	/*If the array is empty.
+	SelectionCore.Num() == 0.*/
+	else
+	{
+		StartWatching();
 	}
 }
 
 void UTargetSelectionComponent::OffWatchingActors()
 {
+	/*The job may be running while the observation is not on yet.*/
+	CancelAsyncWatching();
+
+	/*The filters kept by the auto-targeting are forgotten, the observation doesn't begin again.*/
+	if (bIsAutoTargetingIdle)
+	{
+		bIsAutoTargetingIdle = false;
+		ResetFilters();
+	}
 
 	if (!bIsWatchingNow)
 	{
@@ -307,7 +604,7 @@ void UTargetSelectionComponent::OffWatchingActors()
 		return;
 	}
 
-	if (ObservedActor == nullptr)
+	if (GetObservedActor() == nullptr)
 	{
 		if (bIsDebugMode)
 		{
@@ -317,34 +614,62 @@ void UTargetSelectionComponent::OffWatchingActors()
 		return;
 	}
 
-	CallInterfaceIsNotObserved();
+	ResetFilters();
+	StopWatching();
+}
+
+void UTargetSelectionComponent::StopWatchingAllLeft()
+{
+	if (bIsAutoTargeting && !bIsCustomArray)
+	{
+		CancelAsyncWatching();
+		bIsAutoTargetingIdle = true;
+		StopWatching();
+	}
+	else
+	{
+		OffWatchingActors();
+	}
+}
 
-	ObservedActor = nullptr;
+void UTargetSelectionComponent::ResetFilters()
+{
 	CurrentClassesFilter.Empty();
 	CurrentClassesFilterException.Empty();
 	CurrentInterfaceFilter = nullptr;
+	CurrentFilterProfile = nullptr;
 	FKey NullKey;
 	CurrentInputKey = NullKey;
-	ObservedActorsArr.Empty();
 
 	bIsValidClassesFilter = false;
 	bIsValidClassesFilterException = false;
 	bIsValidInterfaceFilter = false;
+	ClassFilterVerdicts.Reset();
+}
+
+void UTargetSelectionComponent::StopWatching()
+{
+	CallInterfaceIsNotObserved();
+
+	SelectionCore.Reset();
+	LineOfSightCache.Reset();
 
 	bIsWatchingNow = false;
+	UpdateTickEnabled();
 
 	if (bIsCustomArray)
 	{
-		CustomArrayDuplicate.Empty();
+		CustomArrayDuplicate.Reset();
 	}
 	bIsCustomArray = false;
 
+	NotifySelectionChanged();
 
 	OnStateOfTargetSelection.Broadcast(false);
 
 	if (bIsDebugMode)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("TargetSelection: OffWatchingActors(): TargetSelection is switched off."))
+		UE_LOG(LogTemp, Warning, TEXT("TargetSelection: StopWatching(): TargetSelection is switched off."))
 	}
 }
 
@@ -371,22 +696,23 @@ void UTargetSelectionComponent::RemoveAndSwitchActors(AActor* RemovingActor)
 	}
 
 	/*If there is no actor in the array who came out of the collision.*/
-	if (!ObservedActorsArr.Contains(RemovingActor))
+	const FTargetSelectionActorCore::ERemoval Removal = SelectionCore.GetRemoval(RemovingActor);
+	if (Removal == FTargetSelectionActorCore::ERemoval::NotFound)
 	{
 		return;
 	}
 
 	/*If the observed actor is the same as the actor that came out.*/
-	if (ObservedActor == RemovingActor)
+	if (Removal != FTargetSelectionActorCore::ERemoval::Other)
 	{
 		/*If there is one element in the array.*/
-		if (ObservedActorsArr.Num() == 1)
+		if (Removal == FTargetSelectionActorCore::ERemoval::Last)
 		{
 			if (bIsDebugMode)
 			{
 				UE_LOG(LogTemp, Warning, TEXT("TargetSelection: RemoveAndSwitchActors(): Last Actor %s is living collision."), *RemovingActor->GetName());
 			}
-			OffWatchingActors();
+			StopWatchingAllLeft();
 			return;
 		}
 		/*If there is more than 1 element in the array.*/
@@ -396,7 +722,7 @@ void UTargetSelectionComponent::RemoveAndSwitchActors(AActor* RemovingActor)
 			CallInterfaceIsNotObserved();
 
 			/*Remove the observed actor from the array.*/
-			ObservedActorsArr.RemoveAt(IndexOfCurrentObservedActor);
+			SelectionCore.RemoveAt(SelectionCore.GetObservedIndex());
 			if (bIsDebugMode)
 			{
 				UE_LOG(LogTemp, Warning, TEXT("TargetSelection: RemoveAndSwitchActors(): %s removed from ObservedActorsArr."), *RemovingActor->GetName());
@@ -408,33 +734,21 @@ void UTargetSelectionComponent::RemoveAndSwitchActors(AActor* RemovingActor)
 				SortActorsByDistance();
 			}
 
-			/*If allowed, then assign the index of the observed actor 0.*/
-			if (bIsSwitchToFirstActor_WhenRemoveObservedActor)
-			{
-				IndexOfCurrentObservedActor = 0;
-			}
-			else
-			{
-				/*If the current index is outside the array.*/
-				if (IndexOfCurrentObservedActor > ObservedActorsArr.Num() - 1)
-				{
-					IndexOfCurrentObservedActor = 0;
-				}
-			}
-
-			/*Determine the new observed actor by the new index.*/
-			ObservedActor = ObservedActorsArr[IndexOfCurrentObservedActor];
+			/*If allowed, then observe the first actor, else take the actor that followed the removed one.*/
+			SelectionCore.ObserveAfterRemoval(bIsSwitchToFirstActor_WhenRemoveObservedActor);
 
 			/*The actor is being observed.*/
 			CallInterfaceIsObserved();
 
-			OnSwitchActor.Broadcast(ObservedActor);
+			OnSwitchActor.Broadcast(GetObservedActor());
+
+			NotifySelectionChanged();
 
 			if (bIsDebugMode)
 			{
-				if (ObservedActor != nullptr)
+				if (GetObservedActor() != nullptr)
 				{
-					UE_LOG(LogTemp, Warning, TEXT("TargetSelection: RemoveAndSwitchActors(): switch to %s."), *ObservedActor->GetName());
+					UE_LOG(LogTemp, Warning, TEXT("TargetSelection: RemoveAndSwitchActors(): switch to %s."), *GetObservedActor()->GetName());
 				}
 				else
 				{
@@ -447,11 +761,10 @@ void UTargetSelectionComponent::RemoveAndSwitchActors(AActor* RemovingActor)
 	ObservedActor != LosedActor*/
 	else
 	{
-		/*Remove it from the array.*/
-		ObservedActorsArr.RemoveSingle(RemovingActor);
+		/*Remove it from the array. The index of the observed actor moves with it.*/
+		SelectionCore.RemoveAt(SelectionCore.Find(RemovingActor));
 
-		/*Find a new index for the actor being monitored.*/
-		IndexOfCurrentObservedActor = ObservedActorsArr.Find(ObservedActor);
+		NotifySelectionChanged();
 
 		if (bIsDebugMode)
 		{
@@ -488,8 +801,21 @@ void UTargetSelectionComponent::AddActor(AActor* NewActor)
 		return;
 	}
 
+	/*If sorting is allowed and the ordered insertion is chosen, put the actor at its place.*/
+	if (bIsSortArrayOfActors_WhenAddNew && bIsInsertNewActorsInOrder && Owner != nullptr)
+	{
+		InsertActorByDistance(NewActor);
+		NotifySelectionChanged();
+
+		if (bIsDebugMode)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: AddActor(): %s inserted."), *NewActor->GetName());
+		}
+		return;
+	}
+
 	/*If the filter has passed, add the actor to the array.*/
-	ObservedActorsArr.Add(NewActor);
+	AddObservedActor(NewActor);
 
 	if (bIsDebugMode)
 	{
@@ -501,102 +827,541 @@ void UTargetSelectionComponent::AddActor(AActor* NewActor)
 	{
 		SortActorsByDistance();
 	}
+
+	NotifySelectionChanged();
 }
 
-void UTargetSelectionComponent::SetObservedActorByPointer(AActor* NewObservedActor)
+void UTargetSelectionComponent::AddActors(const TArray<AActor*>& NewActors)
 {
-	int32 NewIndex = ObservedActorsArr.Find(NewObservedActor);
-	if (NewIndex == INDEX_NONE)
+	/*If the observation mode is disabled.*/
+	if (!bIsWatchingNow)
 	{
 		if (bIsDebugMode)
 		{
-			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: SetObservedActorByPointer(): NewObservedActor is not presence in ObservedActorsArr, first add it using the method AddActor."));
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: AddActors(): TargetSelection not active."));
 		}
 		return;
 	}
 
-	/*Call the IsNotObserved() interface method.*/
-	CallInterfaceIsNotObserved();
-
-	if (bIsDebugMode)
+	/*Add the actors that passed the filters.*/
+	int32 NumAddedActors = 0;
+	for (AActor* NewActor : NewActors)
 	{
-		UE_LOG(LogTemp, Display, TEXT("TargetSelection: Switch from %s"), *ObservedActor->GetName());
+		if (SortActorByFilters(NewActor))
+		{
+			AddObservedActor(NewActor);
+			++NumAddedActors;
+		}
 	}
 
-	IndexOfCurrentObservedActor = NewIndex;
-	ObservedActor = NewObservedActor;
-
-	/*Call the IsObserved() interface method.*/
-	CallInterfaceIsObserved();
-
-	/*Call up the switching dispatcher.*/
-	OnSwitchActor.Broadcast(ObservedActor);
+	if (NumAddedActors == 0)
+	{
+		return;
+	}
 
-	/*Sort the array if allowed.*/
-	if (bIsSortArrayOfActors_WhenSwitch)
+	/*Sort once for all the new actors. The index keeps pointing at the observed actor.*/
+	if (bIsSortArrayOfActors_WhenAddNew)
 	{
 		SortActorsByDistance();
 	}
 
 	if (bIsDebugMode)
 	{
-		if (ObservedActor != nullptr)
-		{
-			UE_LOG(LogTemp, Display, TEXT("TargetSelection: to %s"), *ObservedActor->GetName());
-		}
-		else
-		{
-			UE_LOG(LogTemp, Error, TEXT("TargetSelection: Observed Actor is not valid."));
-		}
+		UE_LOG(LogTemp, Warning, TEXT("TargetSelection: AddActors(): %d actors added."), NumAddedActors);
 	}
+
+	NotifySelectionChanged();
+
+	OnObservedActorsChanged.Broadcast(NumAddedActors, 0);
 }
 
-void UTargetSelectionComponent::SetObservedActorByIndex(int32 IndexOfNewObservedActor)
+void UTargetSelectionComponent::RemoveActors(const TArray<AActor*>& RemovingActors)
 {
-	if (!ObservedActorsArr.IsValidIndex(IndexOfNewObservedActor))
+	/*If the observation mode is disabled.*/
+	if (!bIsWatchingNow)
 	{
 		if (bIsDebugMode)
 		{
-			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: SetObservedActorByIndex(): IndexOfNewObservedActor is not valid."));
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: RemoveActors(): TargetSelection not active."));
 		}
 		return;
 	}
 
-	/*Call the IsNotObserved() interface method.*/
-	CallInterfaceIsNotObserved();
-
-	if (bIsDebugMode)
+	/*Take only the actors that are in the array. The buffer keeps its memory between the calls.*/
+	TSet<AActor*>& RemovingSet = RemovingActorsBuffer;
+	RemovingSet.Reset();
+	for (AActor* RemovingActor : RemovingActors)
 	{
-		UE_LOG(LogTemp, Display, TEXT("TargetSelection: Switch from %s"), *ObservedActor->GetName());
+		if (SelectionCore.Contains(RemovingActor))
+		{
+			RemovingSet.Add(RemovingActor);
+		}
 	}
 
-	IndexOfCurrentObservedActor = IndexOfNewObservedActor;
-	ObservedActor = ObservedActorsArr[IndexOfNewObservedActor];
-
-	/*Call the IsObserved() interface method.*/
-	CallInterfaceIsObserved();
-
-	/*Call up the switching dispatcher.*/
-	OnSwitchActor.Broadcast(ObservedActor);
-
-	/*Sort the array if allowed.*/
-	if (bIsSortArrayOfActors_WhenSwitch)
+	if (RemovingSet.Num() == 0)
 	{
-		SortActorsByDistance();
+		return;
 	}
 
-	if (bIsDebugMode)
+	const bool bIsObservedActorRemoved = RemovingSet.Contains(GetObservedActor());
+
+	/*If all actors leave, turn off the observation.*/
+	if (RemovingSet.Num() == SelectionCore.GetNumUnique())
 	{
-		if (ObservedActor != nullptr)
-		{
-			UE_LOG(LogTemp, Display, TEXT("TargetSelection: to %s"), *ObservedActor->GetName());
-		}
-		else
+		if (bIsDebugMode)
 		{
-			UE_LOG(LogTemp, Error, TEXT("TargetSelection: Observed Actor is not valid."));
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: RemoveActors(): All %d actors are removed."), RemovingSet.Num());
 		}
+		StopWatchingAllLeft();
+		OnObservedActorsChanged.Broadcast(0, RemovingSet.Num());
+		return;
 	}
-}
+
+	/*Send a signal to the actor that he's not being observed.*/
+	if (bIsObservedActorRemoved)
+	{
+		CallInterfaceIsNotObserved();
+	}
+
+	/*Remove the actors in one pass. The index of the observed actor moves back by the number of the actors removed before it.*/
+	SelectionCore.RemoveAll([&RemovingSet](AActor* CurrentActor) { return RemovingSet.Contains(CurrentActor); });
+
+	if (bIsDebugMode)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("TargetSelection: RemoveActors(): %d actors removed from ObservedActorsArr."), RemovingSet.Num());
+	}
+
+	/*If the observed actor is still in the array, it keeps being observed.*/
+	if (!bIsObservedActorRemoved)
+	{
+		NotifySelectionChanged();
+		OnObservedActorsChanged.Broadcast(0, RemovingSet.Num());
+		return;
+	}
+
+	/*If allowed, then sort it.*/
+	if (bIsSortArrayOfActors_WhenRemove)
+	{
+		SortActorsByDistance();
+	}
+
+	/*If allowed, then observe the first actor, else take the actor that followed the removed one.*/
+	SelectionCore.ObserveAfterRemoval(bIsSwitchToFirstActor_WhenRemoveObservedActor);
+
+	/*The actor is being observed.*/
+	CallInterfaceIsObserved();
+
+	OnSwitchActor.Broadcast(GetObservedActor());
+
+	NotifySelectionChanged();
+
+	OnObservedActorsChanged.Broadcast(0, RemovingSet.Num());
+
+	if (bIsDebugMode)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("TargetSelection: RemoveActors(): switch to %s."), *GetObservedActor()->GetName());
+	}
+}
+
+void UTargetSelectionComponent::SetObservedActorByPointer(AActor* NewObservedActor)
+{
+	const int32 NewIndex = SelectionCore.Find(NewObservedActor);
+	if (NewIndex == INDEX_NONE)
+	{
+		if (bIsDebugMode)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: SetObservedActorByPointer(): NewObservedActor is not presence in ObservedActorsArr, first add it using the method AddActor."));
+		}
+		return;
+	}
+
+	SwitchObservedActor(NewIndex);
+
+	/*Sort the array if allowed.*/
+	if (bIsSortArrayOfActors_WhenSwitch)
+	{
+		SortActorsByDistance();
+	}
+
+	NotifySelectionChanged();
+}
+
+void UTargetSelectionComponent::SetObservedActorByIndex(int32 IndexOfNewObservedActor)
+{
+	if (!SelectionCore.IsValidIndex(IndexOfNewObservedActor))
+	{
+		if (bIsDebugMode)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: SetObservedActorByIndex(): IndexOfNewObservedActor is not valid."));
+		}
+		return;
+	}
+
+	SwitchObservedActor(IndexOfNewObservedActor);
+
+	/*Sort the array if allowed.*/
+	if (bIsSortArrayOfActors_WhenSwitch)
+	{
+		SortActorsByDistance();
+	}
+
+	NotifySelectionChanged();
+}
+
+void UTargetSelectionComponent::SwitchObservedActor(int32 IndexOfNewObservedActor)
+{
+	/*Call the IsNotObserved() interface method. The observed actor that left the array was told so when it was removed.*/
+	if (GetObservedActor() != nullptr)
+	{
+		CallInterfaceIsNotObserved();
+
+		if (bIsDebugMode)
+		{
+			UE_LOG(LogTemp, Display, TEXT("TargetSelection: Switch from %s"), *GetObservedActor()->GetName());
+		}
+	}
+
+	SelectionCore.SetObservedIndex(IndexOfNewObservedActor);
+
+	/*Call the IsObserved() interface method.*/
+	CallInterfaceIsObserved();
+
+	/*Call up the switching dispatcher.*/
+	OnSwitchActor.Broadcast(GetObservedActor());
+
+	if (bIsDebugMode)
+	{
+		if (GetObservedActor() != nullptr)
+		{
+			UE_LOG(LogTemp, Display, TEXT("TargetSelection: to %s"), *GetObservedActor()->GetName());
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("TargetSelection: Observed Actor is not valid."));
+		}
+	}
+}
+
+void UTargetSelectionComponent::RegisterTargetableActor(AActor* TargetableActor)
+{
+	if (UTargetSelectionSubsystem* TargetSelectionSubsystem = GetTargetSelectionSubsystem())
+	{
+		TargetSelectionSubsystem->RegisterTargetableActor(TargetableActor);
+	}
+}
+
+void UTargetSelectionComponent::UnregisterTargetableActor(AActor* TargetableActor)
+{
+	if (UTargetSelectionSubsystem* TargetSelectionSubsystem = GetTargetSelectionSubsystem())
+	{
+		TargetSelectionSubsystem->UnregisterTargetableActor(TargetableActor);
+	}
+}
+
+bool UTargetSelectionComponent::GetObservedActorLocation_AnyThread(FVector& OutLocation) const
+{
+	FTargetSelectionSnapshot Snapshot;
+	SelectionSnapshots.Read(Snapshot);
+	OutLocation = Snapshot.ObservedActorLocation;
+	return Snapshot.ObservedActorKey != FObjectKey();
+}
+
+void UTargetSelectionComponent::NotifySelectionChanged()
+{
+	FTargetSelectionSnapshot NewSnapshot;
+	NewSnapshot.bIsWatching = bIsWatchingNow;
+	NewSnapshot.IndexOfObservedActor = SelectionCore.GetObservedIndex();
+	NewSnapshot.NumObservedActors = SelectionCore.Num();
+	NewSnapshot.NumCandidates = FMath::Min(SelectionCore.Num(), FTargetSelectionSnapshot::MaxCandidates);
+
+	/*Only plain data is published, the readers on the other threads never touch the actors.*/
+	CacheActorLocations();
+	AActor* CurrentObservedActor = GetObservedActor();
+	if (CurrentObservedActor != nullptr)
+	{
+		NewSnapshot.ObservedActorKey = FObjectKey(CurrentObservedActor);
+		NewSnapshot.ObservedActorName = CurrentObservedActor->GetFName();
+		NewSnapshot.ObservedActorLocation = SelectionCore.GetPosition(NewSnapshot.IndexOfObservedActor);
+	}
+	for (int32 Index = 0; Index != NewSnapshot.NumCandidates; Index++)
+	{
+		AActor* CurrentActor = SelectionCore.GetHandle(Index);
+		NewSnapshot.CandidateKeys[Index] = FObjectKey(CurrentActor);
+		NewSnapshot.CandidateDistances[Index] = CurrentActor != nullptr && Owner != nullptr ? FVector::Dist(SelectionCore.GetPosition(Index), OwnerLocationCache) : 0.f;
+	}
+
+	SelectionSnapshots.Publish(NewSnapshot);
+
+	UpdateReplicatedSelection();
+}
+
+void UTargetSelectionComponent::UpdateReplicatedSelection()
+{
+	if (!bIsReplicateSelection || Owner == nullptr || !Owner->HasAuthority())
+	{
+		return;
+	}
+
+	/*The properties that are not changed are not sent.*/
+	FTargetSelectionReplicatedState NewState;
+	NewState.ObservedActor = GetObservedActor();
+	NewState.IndexOfObservedActor = uint16(FMath::Clamp(SelectionCore.GetObservedIndex(), 0, int32(MAX_uint16)));
+	NewState.NumCandidates = uint8(FMath::Clamp(FMath::Min(SelectionCore.Num(), MaxReplicatedCandidates), 0, int32(MAX_uint8)));
+
+	/*The clients are notified once by the state, so it changes with the candidates.*/
+	const bool bIsCandidatesChanged = ReplicatedCandidates.SetCandidates(SelectionCore.GetHandles(), NewState.NumCandidates);
+	NewState.CandidatesVersion = bIsCandidatesChanged ? uint8(ReplicatedState.CandidatesVersion + 1) : ReplicatedState.CandidatesVersion;
+
+	if (NewState.ObservedActor != ReplicatedState.ObservedActor
+		|| NewState.IndexOfObservedActor != ReplicatedState.IndexOfObservedActor
+		|| NewState.NumCandidates != ReplicatedState.NumCandidates
+		|| NewState.CandidatesVersion != ReplicatedState.CandidatesVersion)
+	{
+		ReplicatedState = NewState;
+
+		/*Send the change on the next net update instead of waiting for the update frequency of the owner.*/
+		Owner->ForceNetUpdate();
+	}
+}
+
+bool UTargetSelectionComponent::ServerRequestObservedActor_Validate(AActor* RequestedActor)
+{
+	return true;
+}
+
+void UTargetSelectionComponent::ServerRequestObservedActor_Implementation(AActor* RequestedActor)
+{
+	UTargetSelectionSubsystem* TargetSelectionSubsystem = GetTargetSelectionSubsystem();
+	if (TargetSelectionSubsystem != nullptr)
+	{
+		TargetSelectionSubsystem->QueueSwitchRequest(this, RequestedActor);
+	}
+}
+
+bool UTargetSelectionComponent::ServerRequestObservedIndex_Validate(int32 RequestedIndex)
+{
+	return true;
+}
+
+void UTargetSelectionComponent::ServerRequestObservedIndex_Implementation(int32 RequestedIndex)
+{
+	/*The index is of the array of the server, so the request is checked as the request of the actor at this index.*/
+	if (SelectionCore.IsValidIndex(RequestedIndex))
+	{
+		ServerRequestObservedActor_Implementation(SelectionCore.GetHandle(RequestedIndex));
+	}
+}
+
+bool UTargetSelectionComponent::IsSwitchRequestValid(AActor* RequestedActor, const FVector& RequestedActorLocation) const
+{
+	if (!bIsWatchingNow || Owner == nullptr)
+	{
+		return false;
+	}
+
+	/*The actors of the array already passed the filters.*/
+	if (!SelectionCore.Contains(RequestedActor))
+	{
+		return false;
+	}
+
+	return FVector::DistSquared(RequestedActorLocation, GetCachedActorLocation(Owner)) <= FMath::Square(GetWatchingRadius());
+}
+
+void UTargetSelectionComponent::SetIsAutoTargeting(bool bIsEnabled)
+{
+	if (bIsAutoTargeting == bIsEnabled)
+	{
+		return;
+	}
+	bIsAutoTargeting = bIsEnabled;
+
+	/*Before BeginPlay the component is registered by BeginPlay itself.*/
+	UTargetSelectionSubsystem* TargetSelectionSubsystem = GetTargetSelectionSubsystem();
+	if (!HasBegunPlay() || TargetSelectionSubsystem == nullptr)
+	{
+		return;
+	}
+
+	if (bIsAutoTargeting)
+	{
+		NextAutoTargetingTime = 0.f;
+		TargetSelectionSubsystem->RegisterAutoTargetingComponent(this);
+	}
+	else
+	{
+		TargetSelectionSubsystem->UnregisterAutoTargetingComponent(this);
+
+		/*Nothing begins the idle observation again.*/
+		if (bIsAutoTargetingIdle)
+		{
+			OffWatchingActors();
+		}
+	}
+}
+
+float UTargetSelectionComponent::GetAutoTargetingSignificance_Implementation() const
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr || Owner == nullptr)
+	{
+		return 1.f;
+	}
+
+	/*Without the local player, for example on the dedicated server, every owner is significant.*/
+	const APlayerController* PlayerController = World->GetFirstPlayerController();
+	if (PlayerController == nullptr || !PlayerController->IsLocalController())
+	{
+		return 1.f;
+	}
+
+	float Significance = 1.f;
+	if (AutoTargetingSignificanceDistance > 0.f)
+	{
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+		Significance = 1.f - FMath::Clamp(FVector::Dist(ViewLocation, GetCachedActorLocation(Owner)) / AutoTargetingSignificanceDistance, 0.f, 1.f);
+	}
+
+	if (!Owner->WasRecentlyRendered())
+	{
+		Significance *= AutoTargetingOffScreenSignificance;
+	}
+
+	return Significance;
+}
+
+void UTargetSelectionComponent::UpdateAutoTargeting(float CurrentTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_UpdateAutoTargeting);
+
+	const float Significance = FMath::Clamp(GetAutoTargetingSignificance(), 0.f, 1.f);
+	NextAutoTargetingTime = CurrentTime + FMath::Lerp(FMath::Max(AutoTargetingMaxInterval, AutoTargetingInterval), AutoTargetingInterval, Significance);
+
+	/*The observation is begun by the WatchActors methods, the auto-targeting only keeps the nearest actor.
+	If all the actors left, it is begun again with the kept filters.*/
+	if (!bIsWatchingNow)
+	{
+		if (bIsAutoTargetingIdle)
+		{
+			StartWatching();
+		}
+		return;
+	}
+
+	if (PendingAsyncJob.IsValid())
+	{
+		return;
+	}
+
+	/*Without the collision and the grid the candidates are found by the query, its result is applied by OnOverlapQueryDone().*/
+	if (!bIsCustomArray && TargetSelectionCollision == nullptr && !bIsUseSpatialGrid)
+	{
+		if (!bIsOverlapQueryPending)
+		{
+			StartOverlapQuery();
+		}
+		return;
+	}
+
+	SwitchToNearestActor();
+}
+
+void UTargetSelectionComponent::RefreshObservedActors(int32& OutNumAddedActors, int32& OutNumRemovedActors)
+{
+	/*Remove the actors that left in one pass, the observed actor is switched by the caller.*/
+	TSet<AActor*>& RemovingSet = RemovingActorsBuffer;
+	RemovingSet.Reset();
+	for (AActor* CurrentActor : SelectionCore.GetHandles())
+	{
+		if (CurrentActor == nullptr || CurrentActor->IsPendingKill() || !IsCandidateActor(CurrentActor))
+		{
+			RemovingSet.Add(CurrentActor);
+		}
+	}
+	OutNumRemovedActors = RemovingSet.Num();
+	if (OutNumRemovedActors > 0)
+	{
+		/*The observed actor that left is told so now, nothing is observed until the caller switches.*/
+		if (GetObservedActor() != nullptr && RemovingSet.Contains(GetObservedActor()))
+		{
+			CallInterfaceIsNotObserved();
+		}
+		SelectionCore.RemoveAll([&RemovingSet](AActor* CurrentActor) { return RemovingSet.Contains(CurrentActor); });
+	}
+
+	/*Add the candidates that are not observed yet and passed the filters.*/
+	CandidateActorsBuffer.Reset();
+	GetCandidateActors(CandidateActorsBuffer);
+	OutNumAddedActors = 0;
+	for (AActor* CandidateActor : CandidateActorsBuffer)
+	{
+		if (CandidateActor != nullptr && !SelectionCore.Contains(CandidateActor) && SortActorByFilters(CandidateActor))
+		{
+			AddObservedActor(CandidateActor);
+			++OutNumAddedActors;
+		}
+	}
+}
+
+void UTargetSelectionComponent::SwitchToNearestActor()
+{
+	const int32 NumSortsBefore = NumPerformedSorts;
+	int32 NumAddedActors = 0;
+	int32 NumRemovedActors = 0;
+
+	/*The outside array is not taken again, only sorted.*/
+	if (!bIsCustomArray)
+	{
+		RefreshObservedActors(NumAddedActors, NumRemovedActors);
+
+		/*All actors left. The filters are kept, the observation begins again when the candidates appear.*/
+		if (SelectionCore.Num() == 0)
+		{
+			StopWatchingAllLeft();
+			OnObservedActorsChanged.Broadcast(0, NumRemovedActors);
+			return;
+		}
+	}
+
+	SortActorsByDistance();
+
+	/*The final target is known after the refresh and the sort, so it is switched once, even if the observed actor left.
+	The array is already sorted, it is not sorted again by bIsSortArrayOfActors_WhenSwitch.*/
+	if (SelectionCore.Num() > 0 && (!SelectionCore.HasObserved() || SelectionCore.GetHandle(0) != GetObservedActor()))
+	{
+		SwitchObservedActor(0);
+		NotifySelectionChanged();
+	}
+	/*The observed actor is the same, only the order of the candidates might change.*/
+	else if (NumPerformedSorts != NumSortsBefore || NumAddedActors > 0 || NumRemovedActors > 0)
+	{
+		NotifySelectionChanged();
+	}
+
+	if (NumAddedActors > 0 || NumRemovedActors > 0)
+	{
+		OnObservedActorsChanged.Broadcast(NumAddedActors, NumRemovedActors);
+	}
+}
+
+void UTargetSelectionComponent::GetReplicatedCandidates(TArray<AActor*>& OutCandidates) const
+{
+	ReplicatedCandidates.GetCandidates(OutCandidates, ReplicatedState.NumCandidates);
+}
+
+void UTargetSelectionComponent::OnRep_ReplicatedSelection()
+{
+	OnReplicatedSelectionChanged.Broadcast(ReplicatedState.ObservedActor);
+}
+
+UTargetSelectionSubsystem* UTargetSelectionComponent::GetTargetSelectionSubsystem() const
+{
+	UWorld* World = GetWorld();
+	UGameInstance* GameInstance = World != nullptr ? World->GetGameInstance() : nullptr;
+	return GameInstance != nullptr ? GameInstance->GetSubsystem<UTargetSelectionSubsystem>() : nullptr;
+}
 
 uint32 UTargetSelectionComponent::CheckInputData_InputKey(FKey InputKey)
 {
@@ -731,107 +1496,524 @@ bool UTargetSelectionComponent::CheckInputData_Interface(TSubclassOf<UInterface>
 bool UTargetSelectionComponent::SwitchCurrentActors()
 {
 	/*If there is only 1 element in the array.*/
-	if (ObservedActorsArr.Num() == 1)
+	if (SelectionCore.Num() == 1)
 	{
 		if (bIsDebugMode)
 		{
-			UE_LOG(LogTemp, Display, TEXT("TargetSelection: No switch, stay on %s"), *ObservedActor->GetName());
+			UE_LOG(LogTemp, Display, TEXT("TargetSelection: No switch, stay on %s"), *GetObservedActor()->GetName());
 		}
 		/*Don't do anything and get out.*/
 		return true;
 	}
 	/*If there is more than 1 element in the array.
-	ObservedActorsArr.Num() > 1.*/
+	SelectionCore.Num() > 1.*/
 	else
 	{
-		/*Call the IsNotObserved() interface method.*/
-		CallInterfaceIsNotObserved();
+		/*Take the next index, or 0 after the last one. Only the nearest actors are cycled through if it is set.*/
+		SwitchObservedActor(SelectionCore.GetNextObservedIndex(NumberOfNearestActorsToOrder));
+
+		/*Sort the array if allowed.*/
+		if (bIsSortArrayOfActors_WhenSwitch)
+		{
+			SortActorsByDistance();
+		}
+
+		NotifySelectionChanged();
+	}
+
+	return true;
+}
+
+bool UTargetSelectionComponent::SwitchToNewActor()
+{
+
+	/*Identify the actor to be observed.*/
+	SelectionCore.SetObservedIndex(0);
+
+	/*Call the IsObserved() interface method.*/
+	CallInterfaceIsObserved();
+
+	/*Call up the switching dispatcher.*/
+	OnSwitchActor.Broadcast(GetObservedActor());
+
+	/*Indicate the state of observation.*/
+	bIsWatchingNow = true;
+	bIsAutoTargetingIdle = false;
+	UpdateTickEnabled();
+
+	NotifySelectionChanged();
+
+	/*Call the dispatcher for observation.*/
+	OnStateOfTargetSelection.Broadcast(bIsWatchingNow);
+
+	if (bIsDebugMode)
+	{
+		UE_LOG(LogTemp, Display, TEXT("TargetSelection: First switch to %s"), *GetObservedActor()->GetName());
+	}
+
+	return true;
+}
+
+void UTargetSelectionComponent::StartWatching()
+{
+	/*The previous press is being processed.*/
+	if (PendingAsyncJob.IsValid() || bIsOverlapQueryPending)
+	{
+		return;
+	}
+
+	/*Without the collision and the grid the candidates are found by the query first.*/
+	if (TargetSelectionCollision == nullptr && !bIsUseSpatialGrid)
+	{
+		StartOverlapQuery();
+		return;
+	}
+
+	WatchCandidateActors();
+}
 
+void UTargetSelectionComponent::WatchCandidateActors()
+{
+	if (bIsUseAsyncWatching)
+	{
+		StartAsyncWatching();
+		return;
+	}
+
+	/*Take actors to the array of observed actors.
+	If the array is not empty, continue.*/
+	if (GetAvailableActors())
+	{
+		/*Sort the array if allowed.*/
+		if (bIsSortArrayOfActors_WhenBegin)
+		{
+			SortActorsByDistance();
+		}
+		SwitchToNewActor();
+	}
+}
+
+void UTargetSelectionComponent::StartOverlapQuery()
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr || Owner == nullptr)
+	{
 		if (bIsDebugMode)
 		{
-			UE_LOG(LogTemp, Display, TEXT("TargetSelection: Switch from %s"), *ObservedActor->GetName());
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: StartOverlapQuery(): World or Owner is not valid."));
 		}
+		return;
+	}
+
+	FCollisionObjectQueryParams ObjectQueryParams(FCollisionObjectQueryParams::AllObjects);
+	if (bIsUseTargetableChannel)
+	{
+		ObjectQueryParams = FCollisionObjectQueryParams(TargetableChannel.GetValue());
+	}
+	else if (OverlapQueryObjectTypes.Num() > 0)
+	{
+		ObjectQueryParams = FCollisionObjectQueryParams(OverlapQueryObjectTypes);
+	}
 
-		/*If the current index is less than the maximum index.*/
-		if (IndexOfCurrentObservedActor < ObservedActorsArr.Num() - 1)
+	/*The overlaps of the collision don't include the owner, so the query doesn't too.*/
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(TargetSelectionOverlapQuery), false, Owner);
+
+	FOverlapDelegate OverlapDelegate = FOverlapDelegate::CreateUObject(this, &UTargetSelectionComponent::OnOverlapQueryDone, ++OverlapQuerySequence);
+	World->AsyncOverlapByObjectType(Owner->GetActorLocation(), FQuat::Identity, ObjectQueryParams,
+		FCollisionShape::MakeSphere(OverlapQueryRadius), QueryParams, &OverlapDelegate);
+
+	bIsOverlapQueryPending = true;
+}
+
+void UTargetSelectionComponent::OnOverlapQueryDone(const FTraceHandle& TraceHandle, FOverlapDatum& OverlapDatum, uint32 QuerySequence)
+{
+	/*The query was forgotten by OffWatchingActors() or a newer query was sent.*/
+	if (!bIsOverlapQueryPending || QuerySequence != OverlapQuerySequence)
+	{
+		return;
+	}
+	bIsOverlapQueryPending = false;
+
+	/*An actor is found once for every its component.*/
+	OverlapQueryActors.Reset();
+	for (const FOverlapResult& Overlap : OverlapDatum.OutOverlaps)
+	{
+		AActor* OverlappedActor = Overlap.GetActor();
+		if (OverlappedActor != nullptr && OverlappedActor != Owner)
 		{
-			/*Increase the index by 1.*/
-			++IndexOfCurrentObservedActor;
+			OverlapQueryActors.Add(OverlappedActor);
 		}
-		/*If the current index is equal to or greater than the maximum index.*/
-		else
+	}
+
+	/*The observation might begin with the outside array while the query was running.
+	If it is on, the query was sent by the auto-targeting.*/
+	if (bIsWatchingNow || SelectionCore.Num() > 0)
+	{
+		if (bIsWatchingNow && bIsAutoTargeting && !bIsCustomArray)
 		{
-			/*Zero it.*/
-			IndexOfCurrentObservedActor = 0;
+			SwitchToNearestActor();
 		}
-		/*Change the actor to be observed.*/
-		ObservedActor = ObservedActorsArr[IndexOfCurrentObservedActor];
+		return;
+	}
+
+	if (OverlapQueryActors.Num() == 0)
+	{
+		if (bIsDebugMode)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: OnOverlapQueryDone(): No Actors in radius."));
+		}
+		return;
+	}
 
-		/*Call the IsObserved() interface method.*/
-		CallInterfaceIsObserved();
+	WatchCandidateActors();
+}
 
-		/*Call up the switching dispatcher.*/
-		OnSwitchActor.Broadcast(ObservedActor);
+void UTargetSelectionComponent::StartAsyncWatching()
+{
+	/*Copy the candidates, the filters and the locations.*/
+	TSharedPtr<FTargetSelectionAsyncJob, ESPMode::ThreadSafe> NewJob = MakeShared<FTargetSelectionAsyncJob, ESPMode::ThreadSafe>();
 
-		/*Sort the array if allowed.*/
-		if (bIsSortArrayOfActors_WhenSwitch)
+	CandidateActorsBuffer.Reset();
+	GetCandidateActors(CandidateActorsBuffer);
+	for (AActor* CurrentActor : CandidateActorsBuffer)
+	{
+		if (CurrentActor != nullptr)
 		{
-			SortActorsByDistance();
+			NewJob->AddCandidate(CurrentActor, GetCachedActorLocation(CurrentActor));
 		}
+	}
+
+	if (NewJob->Candidates.Num() == 0)
+	{
+		if (bIsDebugMode)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: StartAsyncWatching(): No Actors in collision."));
+		}
+		return;
+	}
+
+	GetCurrentCompiledFilter(NewJob->Filter);
+	NewJob->WatchSequence = AsyncWatchSequence;
+	NewJob->bIsSortByDistance = bIsSortArrayOfActors_WhenBegin && Owner != nullptr;
+	if (Owner != nullptr)
+	{
+		NewJob->OwnerLocation = GetCachedActorLocation(Owner);
+	}
+
+	PendingAsyncJob = NewJob;
+	UpdateTickEnabled();
+
+	/*The job is captured by value, so it lives until the task ends even if it was cancelled.*/
+	FFunctionGraphTask::CreateAndDispatchWhenReady([NewJob]()
+	{
+		NewJob->Run();
+	}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+
+	if (bIsDebugMode)
+	{
+		UE_LOG(LogTemp, Display, TEXT("TargetSelection: StartAsyncWatching(): %d candidates sent to the task graph."), NewJob->Candidates.Num());
+	}
+}
+
+void UTargetSelectionComponent::ApplyAsyncWatching()
+{
+	TSharedPtr<FTargetSelectionAsyncJob, ESPMode::ThreadSafe> FinishedJob = PendingAsyncJob;
+	PendingAsyncJob.Reset();
+	UpdateTickEnabled();
+
+	/*The job was started for a forgotten request, or the observation already began with the other actors.*/
+	if (FinishedJob->WatchSequence != AsyncWatchSequence || bIsCustomArray || SelectionCore.Num() > 0)
+	{
+		if (bIsDebugMode)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: ApplyAsyncWatching(): The result of a forgotten request is dropped."));
+		}
+		return;
+	}
+
+	/*The actors might be destroyed while the job was running.*/
+	for (const TWeakObjectPtr<AActor>& PassedActor : FinishedJob->Result)
+	{
+		if (PassedActor.IsValid() && CheckLineOfSight(PassedActor.Get()))
+		{
+			AddObservedActor(PassedActor.Get());
+		}
+	}
+
+	if (SelectionCore.Num() == 0)
+	{
+		if (bIsDebugMode)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: ApplyAsyncWatching(): No Actors in ObservedActorsArr."));
+		}
+		return;
+	}
+
+	SwitchToNewActor();
+}
+
+void UTargetSelectionComponent::CancelAsyncWatching()
+{
+	/*The result of the query comes anyway, it is skipped by the flag.*/
+	bIsOverlapQueryPending = false;
+
+	/*The older jobs have the other number, ApplyAsyncWatching() drops their results.*/
+	++AsyncWatchSequence;
+
+	if (!PendingAsyncJob.IsValid())
+	{
+		return;
+	}
+
+	/*The task checks the flag and stops, the result is never applied.*/
+	PendingAsyncJob->bIsCancelled = true;
+	PendingAsyncJob.Reset();
+	UpdateTickEnabled();
+
+	if (bIsDebugMode)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("TargetSelection: CancelAsyncWatching(): The job is cancelled."));
+	}
+}
+
+void UTargetSelectionComponent::SetIsCheckLineOfSight(bool bIsEnabled)
+{
+	if (bIsCheckLineOfSight == bIsEnabled)
+	{
+		return;
+	}
+	bIsCheckLineOfSight = bIsEnabled;
+	UpdateTickEnabled();
+}
+
+void UTargetSelectionComponent::UpdateTickEnabled()
+{
+	SetComponentTickEnabled(PendingAsyncJob.IsValid() || (bIsCheckLineOfSight && bIsWatchingNow));
+}
+
+bool UTargetSelectionComponent::CheckLineOfSight(AActor* CurrentActor)
+{
+	if (!bIsCheckLineOfSight || Owner == nullptr)
+	{
+		return true;
+	}
+
+	FTargetSelectionVisibility& Visibility = LineOfSightCache.FindOrAdd(CurrentActor);
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	if (Visibility.CheckTime >= 0.f && CurrentTime - Visibility.CheckTime <= LineOfSightCacheLifetime)
+	{
+		return Visibility.bIsVisible;
+	}
+
+	/*The actor is observed until the trace finds it hidden.*/
+	Visibility.Actor = CurrentActor;
+	if (!Visibility.bIsTracePending)
+	{
+		RequestLineOfSight(CurrentActor, Visibility);
+	}
+	return true;
+}
+
+bool UTargetSelectionComponent::RequestLineOfSight(AActor* CurrentActor, FTargetSelectionVisibility& Visibility)
+{
+	UWorld* World = GetWorld();
+
+	/*Rendered actors are seen by the camera, no trace is needed.*/
+	if (bIsRecentlyRenderedVisible && CurrentActor->WasRecentlyRendered())
+	{
+		Visibility.CheckTime = World->GetTimeSeconds();
+		Visibility.bIsVisible = true;
+		return true;
+	}
+
+	if (LineOfSightTraceFrame != GFrameCounter)
+	{
+		LineOfSightTraceFrame = GFrameCounter;
+		NumLineOfSightTraces = 0;
+	}
+	if (NumLineOfSightTraces >= MaxLineOfSightTracesPerFrame)
+	{
+		return false;
+	}
+	++NumLineOfSightTraces;
+
+	FVector TraceStart;
+	FRotator EyesRotation;
+	Owner->GetActorEyesViewPoint(TraceStart, EyesRotation);
+
+	/*Only the obstacles block the trace, not the owner and the actor themselves.*/
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(TargetSelectionLineOfSight), false, Owner);
+	QueryParams.AddIgnoredActor(CurrentActor);
+
+	FTraceDelegate TraceDelegate = FTraceDelegate::CreateUObject(this, &UTargetSelectionComponent::OnLineOfSightTraced, TWeakObjectPtr<AActor>(CurrentActor));
+	World->AsyncLineTraceByChannel(EAsyncTraceType::Single, TraceStart, GetCachedActorLocation(CurrentActor), LineOfSightChannel,
+		QueryParams, FCollisionResponseParams::DefaultResponseParam, &TraceDelegate);
+
+	Visibility.bIsTracePending = true;
+	return true;
+}
+
+void UTargetSelectionComponent::UpdateLineOfSight()
+{
+	if (!bIsCheckLineOfSight || !bIsWatchingNow || Owner == nullptr)
+	{
+		return;
+	}
+
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	for (auto It = LineOfSightCache.CreateIterator(); It; ++It)
+	{
+		FTargetSelectionVisibility& Visibility = It.Value();
+		if (Visibility.bIsTracePending || (Visibility.CheckTime >= 0.f && CurrentTime - Visibility.CheckTime <= LineOfSightCacheLifetime))
+		{
+			continue;
+		}
+
+		/*Forget the destroyed actors and the hidden ones that are not candidates anymore.*/
+		AActor* CurrentActor = Visibility.Actor.Get();
+		if (CurrentActor == nullptr || (!SelectionCore.Contains(CurrentActor) && !IsCandidateActor(CurrentActor)))
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+
+		if (!RequestLineOfSight(CurrentActor, Visibility))
+		{
+			return;
+		}
+	}
+
+	/*The actors taken without the filters, for example from the outside array, are traced too.*/
+	for (AActor* CurrentActor : SelectionCore.GetHandles())
+	{
+		if (!LineOfSightCache.Contains(CurrentActor))
+		{
+			FTargetSelectionVisibility& Visibility = LineOfSightCache.Add(CurrentActor);
+			Visibility.Actor = CurrentActor;
+			if (!RequestLineOfSight(CurrentActor, Visibility))
+			{
+				return;
+			}
+		}
+	}
+}
+
+void UTargetSelectionComponent::OnLineOfSightTraced(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum, TWeakObjectPtr<AActor> TracedActor)
+{
+	AActor* CurrentActor = TracedActor.Get();
+	FTargetSelectionVisibility* Visibility = CurrentActor != nullptr ? LineOfSightCache.Find(CurrentActor) : nullptr;
+
+	/*The actor is destroyed or the observation was turned off meanwhile.*/
+	if (Visibility == nullptr)
+	{
+		return;
+	}
+
+	Visibility->bIsTracePending = false;
+	Visibility->CheckTime = GetWorld()->GetTimeSeconds();
+	Visibility->bIsVisible = TraceDatum.OutHits.Num() == 0 || !TraceDatum.OutHits[0].bBlockingHit;
+
+	if (!bIsWatchingNow)
+	{
+		return;
+	}
 
+	const bool bIsObserved = SelectionCore.Contains(CurrentActor);
+	if (!Visibility->bIsVisible && bIsObserved)
+	{
 		if (bIsDebugMode)
 		{
-			if (ObservedActor != nullptr)
-			{
-				UE_LOG(LogTemp, Display, TEXT("TargetSelection: to %s"), *ObservedActor->GetName());
-			}
-			else
-			{
-				UE_LOG(LogTemp, Error, TEXT("TargetSelection: Observed Actor is not valid."));
-			}
-
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: OnLineOfSightTraced(): %s is hidden."), *CurrentActor->GetName());
 		}
+		RemoveAndSwitchActors(CurrentActor);
+	}
+	else if (Visibility->bIsVisible && !bIsObserved && IsCandidateActor(CurrentActor))
+	{
+		AddActor(CurrentActor);
 	}
-
-	return true;
 }
 
-bool UTargetSelectionComponent::SwitchToNewActor()
+float UTargetSelectionComponent::GetWatchingRadius() const
 {
+	return TargetSelectionCollision != nullptr ? TargetSelectionCollision->GetScaledSphereRadius() : OverlapQueryRadius;
+}
 
-	/*Identify the actor to be observed.*/
-	ObservedActor = ObservedActorsArr[0];
-
-	/*Determine the index of the observed actor in the array.*/
-	IndexOfCurrentObservedActor = 0;
+bool UTargetSelectionComponent::IsCandidateActor(AActor* CurrentActor) const
+{
+	if (bIsCustomArray)
+	{
+		return CustomArrayDuplicate.Contains(CurrentActor);
+	}
 
-	/*Call the IsObserved() interface method.*/
-	CallInterfaceIsObserved();
+	if (bIsUseSpatialGrid)
+	{
+		const UTargetSelectionSubsystem* TargetSelectionSubsystem = GetTargetSelectionSubsystem();
+		const FVector* FoundLocation = TargetSelectionSubsystem != nullptr ? TargetSelectionSubsystem->FindTargetableActorLocation(CurrentActor) : nullptr;
+		return FoundLocation != nullptr && Owner != nullptr
+			&& FVector::DistSquared(*FoundLocation, GetCachedActorLocation(Owner)) <= FMath::Square(GetWatchingRadius());
+	}
 
-	/*Call up the switching dispatcher.*/
-	OnSwitchActor.Broadcast(ObservedActor);
+	/*The candidates are the actors found by the last query.*/
+	if (TargetSelectionCollision == nullptr)
+	{
+		return OverlapQueryActors.Contains(CurrentActor);
+	}
 
-	/*Indicate the state of observation.*/
-	bIsWatchingNow = true;
+	if (bIsUpdateActorsByOverlaps)
+	{
+		return OverlappedCandidates.Contains(CurrentActor);
+	}
 
-	/*Call the dispatcher for observation.*/
-	OnStateOfTargetSelection.Broadcast(bIsWatchingNow);
+	return TargetSelectionCollision->IsOverlappingActor(CurrentActor);
+}
 
-	if (bIsDebugMode)
+void UTargetSelectionComponent::GetCurrentCompiledFilter(FTargetSelectionCompiledFilter& OutFilter)
+{
+	if (CurrentFilterProfile != nullptr)
 	{
-		UE_LOG(LogTemp, Display, TEXT("TargetSelection: First switch to %s"), *ObservedActor->GetName());
+		OutFilter = CurrentFilterProfile->GetCompiledFilter();
+		return;
 	}
 
-	return true;
+	/*The same filters as CheckClassByFiltersUncached() uses.*/
+	OutFilter.Reset();
+	if (bIsValidClassesFilter)
+	{
+		for (auto& CurrentClass : CurrentClassesFilter)
+		{
+			OutFilter.IncludeClasses.Add(CurrentClass);
+		}
+	}
+	if (bIsValidClassesFilterException)
+	{
+		for (auto& CurrentClassException : CurrentClassesFilterException)
+		{
+			OutFilter.ExcludeClasses.Add(CurrentClassException);
+		}
+	}
+	if (bIsValidInterfaceFilter)
+	{
+		OutFilter.InterfaceClass = CurrentInterfaceFilter;
+	}
 }
 
 void UTargetSelectionComponent::CallInterfaceIsObserved()
 {
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_CallInterfaceIsObserved);
+
 	/*If the actor is valid.*/
+	AActor* ObservedActor = GetObservedActor();
 	if (ObservedActor != nullptr)
 	{
+		const FTargetSelectionObserverDispatch& ObserverDispatch = GetObserverDispatch(ObservedActor);
+
+		/*If the C++ interface is valid, call it directly.*/
+		if (ObserverDispatch.bIsImplementsNativeInterface)
+		{
+			Cast<ITargetSelectionNativeInterface>(ObservedActor)->OnObserved();
+		}
 		/*If the interface is valid.*/
-		if (ObservedActor->GetClass()->ImplementsInterface(UTargetSelectionInterface::StaticClass()))
+		else if (ObserverDispatch.bIsImplementsInterface)
 		{
 			/*Call the signal that the actor is being observed.*/
 			ITargetSelectionInterface::Execute_IsObserved(ObservedActor);
@@ -856,11 +2038,21 @@ void UTargetSelectionComponent::CallInterfaceIsObserved()
 
 void UTargetSelectionComponent::CallInterfaceIsNotObserved()
 {
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_CallInterfaceIsNotObserved);
+
 	/*If the actor is valid.*/
+	AActor* ObservedActor = GetObservedActor();
 	if (ObservedActor != nullptr)
 	{
+		const FTargetSelectionObserverDispatch& ObserverDispatch = GetObserverDispatch(ObservedActor);
+
+		/*If the C++ interface is valid, call it directly.*/
+		if (ObserverDispatch.bIsImplementsNativeInterface)
+		{
+			Cast<ITargetSelectionNativeInterface>(ObservedActor)->OnNotObserved();
+		}
 		/*If the interface is valid.*/
-		if (ObservedActor->GetClass()->ImplementsInterface(UTargetSelectionInterface::StaticClass()))
+		else if (ObserverDispatch.bIsImplementsInterface)
 		{
 			/*Call the signal that the actor is not being observed.*/
 			ITargetSelectionInterface::Execute_IsNotObserved(ObservedActor);
@@ -883,26 +2075,58 @@ void UTargetSelectionComponent::CallInterfaceIsNotObserved()
 	}
 }
 
+const FTargetSelectionObserverDispatch& UTargetSelectionComponent::GetObserverDispatch(AActor* CurrentActor)
+{
+	UClass* ActorClass = CurrentActor->GetClass();
+	const FObjectKey ClassKey(ActorClass);
+	if (const FTargetSelectionObserverDispatch* FoundDispatch = ObserverDispatches.Find(ClassKey))
+	{
+		return *FoundDispatch;
+	}
+
+	FTargetSelectionObserverDispatch NewDispatch;
+
+	NewDispatch.bIsImplementsNativeInterface = ActorClass->ImplementsInterface(UTargetSelectionNativeInterface::StaticClass());
+	NewDispatch.bIsImplementsInterface = ActorClass->ImplementsInterface(UTargetSelectionInterface::StaticClass());
+
+	return ObserverDispatches.Add(ClassKey, NewDispatch);
+}
+
 bool UTargetSelectionComponent::GetAvailableActors()
 {
-	/*Temporary array.*/
-	TArray<AActor*> TempArrayOfActors;
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_GetAvailableActors);
+	CSV_SCOPED_TIMING_STAT(TargetSelection, GetAvailableActors);
 
-	/*Take the actors to the temporary array.*/
-	TargetSelectionCollision->GetOverlappingActors(TempArrayOfActors);
+	/*Take the actors to the buffer. The buffer keeps its memory between the calls.*/
+	CandidateActorsBuffer.Reset();
+	GetCandidateActors(CandidateActorsBuffer);
+	const int32 NumActorsBefore = SelectionCore.Num();
 
-	/*Scans an array of actors.*/
-	for (auto& CurrentActor : TempArrayOfActors)
+	/*If there are a lot of actors, filter them on the worker threads.*/
+	if (ParallelProcessingThreshold > 0 && CandidateActorsBuffer.Num() >= ParallelProcessingThreshold)
+	{
+		FilterActorsInParallel(CandidateActorsBuffer);
+	}
+	else
 	{
-		if (SortActorByFilters(CurrentActor))
+		/*Scans an array of actors.*/
+		for (auto& CurrentActor : CandidateActorsBuffer)
 		{
-			/*If the filter has passed, add the actor to the array.*/
-			ObservedActorsArr.Add(CurrentActor);
-		}
+			if (SortActorByFilters(CurrentActor))
+			{
+				/*If the filter has passed, add the actor to the array.*/
+				AddObservedActor(CurrentActor);
+			}
 
+		}
 	}
 
-	if (ObservedActorsArr.Num() == 0)
+	INC_DWORD_STAT_BY(STAT_TargetSelection_NumCandidatesScanned, CandidateActorsBuffer.Num());
+	INC_DWORD_STAT_BY(STAT_TargetSelection_NumCandidatesFiltered, SelectionCore.Num() - NumActorsBefore);
+	CSV_CUSTOM_STAT(TargetSelection, CandidatesScanned, CandidateActorsBuffer.Num(), ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(TargetSelection, CandidatesFiltered, SelectionCore.Num() - NumActorsBefore, ECsvCustomStatOp::Accumulate);
+
+	if (SelectionCore.Num() == 0)
 	{
 		if (bIsDebugMode)
 		{
@@ -914,8 +2138,76 @@ bool UTargetSelectionComponent::GetAvailableActors()
 	return true;
 }
 
+void UTargetSelectionComponent::GetCandidateActors(TArray<AActor*>& OutActors)
+{
+	if (bIsUseSpatialGrid)
+	{
+		/*Take the registered actors within the radius of the collision, without the physics overlaps.*/
+		UTargetSelectionSubsystem* TargetSelectionSubsystem = GetTargetSelectionSubsystem();
+		if (Owner != nullptr && TargetSelectionSubsystem != nullptr)
+		{
+			TargetSelectionSubsystem->QueryTargetableActors(Owner->GetActorLocation(), GetWatchingRadius(), CurrentFilterProfile, OutActors);
+			/*The overlaps don't include the owner, so the grid doesn't too.*/
+			OutActors.RemoveSingle(Owner);
+		}
+	}
+	/*The candidates were found by the last overlap query.*/
+	else if (TargetSelectionCollision == nullptr)
+	{
+		OutActors.Reserve(OutActors.Num() + OverlapQueryActors.Num());
+		for (AActor* CandidateActor : OverlapQueryActors)
+		{
+			OutActors.Add(CandidateActor);
+		}
+	}
+	/*The candidates are kept by the overlap events, the physics is not asked.*/
+	else if (bIsUpdateActorsByOverlaps)
+	{
+		OutActors.Reserve(OutActors.Num() + OverlappedCandidates.Num());
+		for (AActor* CandidateActor : OverlappedCandidates)
+		{
+			OutActors.Add(CandidateActor);
+		}
+	}
+	else
+	{
+		TargetSelectionCollision->GetOverlappingActors(OutActors);
+	}
+}
+
+void UTargetSelectionComponent::OnTargetSelectionBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+{
+	if (OtherActor == nullptr || OtherActor == Owner)
+	{
+		return;
+	}
+
+	/*An actor overlaps once for every its component.*/
+	bool bIsAlreadyInSet = false;
+	OverlappedCandidates.Add(OtherActor, &bIsAlreadyInSet);
+	if (!bIsAlreadyInSet && bIsWatchingNow && !bIsCustomArray)
+	{
+		AddActor(OtherActor);
+	}
+}
+
+void UTargetSelectionComponent::OnTargetSelectionEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+{
+	/*The actor leaves when the last of its components stops overlapping.*/
+	if (OtherActor == nullptr || TargetSelectionCollision->IsOverlappingActor(OtherActor))
+	{
+		return;
+	}
+
+	if (OverlappedCandidates.Remove(OtherActor) > 0 && bIsWatchingNow && !bIsCustomArray)
+	{
+		RemoveAndSwitchActors(OtherActor);
+	}
+}
+
 bool UTargetSelectionComponent::SortActorByFilters(AActor* CurrentActor)
 {
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_SortActorByFilters);
 
 	if (CurrentActor == nullptr)
 	{
@@ -926,9 +2218,9 @@ bool UTargetSelectionComponent::SortActorByFilters(AActor* CurrentActor)
 		return false;
 	}
 
-	if (ObservedActorsArr.Num() > 0 && bIsCheckAddingActorsForDuplicates)
+	if (SelectionCore.Num() > 0 && bIsCheckAddingActorsForDuplicates)
 	{
-		if (ObservedActorsArr.Contains(CurrentActor))
+		if (SelectionCore.Contains(CurrentActor))
 		{
 			if (bIsDebugMode)
 			{
@@ -938,15 +2230,39 @@ bool UTargetSelectionComponent::SortActorByFilters(AActor* CurrentActor)
 		}
 	}
 
-	/*If allowed, go through the copy of the outside array and find matches with CurrentActor.*/
-	if (bIsCustomArray)
+	/*If allowed, go through the copy of the outside array and find matches with CurrentActor.
+	The filters by class and interface give the same result for all actors of the class.*/
+	const bool bIsPassed = (bIsCustomArray && CustomArrayDuplicate.Contains(CurrentActor)) || CheckClassByFilters(CurrentActor->GetClass());
+
+	/*The line of sight is checked last, it is the most expensive.*/
+	return bIsPassed && CheckLineOfSight(CurrentActor);
+
+}
+
+bool UTargetSelectionComponent::CheckClassByFilters(UClass* ActorClass)
+{
+	/*If the filter profile is used, it has its own cache.*/
+	if (CurrentFilterProfile != nullptr)
 	{
-		if (CustomArrayDuplicate.Contains(CurrentActor))
-		{
-			return true;
-		}
+		return CurrentFilterProfile->GetCompiledFilter().CheckClass(ActorClass);
+	}
+
+	/*If the class was checked before, take the result.*/
+	if (const bool* CachedVerdict = ClassFilterVerdicts.Find(ActorClass))
+	{
+		return *CachedVerdict;
 	}
 
+	const bool bIsPassed = CheckClassByFiltersUncached(ActorClass);
+	ClassFilterVerdicts.Add(ActorClass, bIsPassed);
+
+	return bIsPassed;
+}
+
+bool UTargetSelectionComponent::CheckClassByFiltersUncached(UClass* ActorClass) const
+{
+	bool bIsPassed = true;
+
 	/*If the filter is valid.*/
 	if (bIsValidClassesFilter)
 	{
@@ -956,7 +2272,7 @@ bool UTargetSelectionComponent::SortActorByFilters(AActor* CurrentActor)
 		for (auto& CurrenClass : CurrentClassesFilter)
 		{
 			/*If the class matches or is a child filter, remember the result and exit the loop.*/
-			if (UKismetMathLibrary::ClassIsChildOf(CurrentActor->GetClass(), CurrenClass))
+			if (UKismetMathLibrary::ClassIsChildOf(ActorClass, CurrenClass))
 			{
 				bIsClassesFilterWorkOut = true;
 				break;
@@ -965,12 +2281,12 @@ bool UTargetSelectionComponent::SortActorByFilters(AActor* CurrentActor)
 		/*If the filter's triggered, get out.*/
 		if (!bIsClassesFilterWorkOut)
 		{
-			return false;
+			bIsPassed = false;
 		}
 	}
 
 	/*If the filter is valid.*/
-	if (bIsValidClassesFilterException)
+	if (bIsPassed && bIsValidClassesFilterException)
 	{
 		/*Suppose that the filter array does not contain the CurrentActor actor class.*/
 		bool bIsClassesFilterExceptionWorkOut = false;
@@ -978,7 +2294,7 @@ bool UTargetSelectionComponent::SortActorByFilters(AActor* CurrentActor)
 		for (auto& CurrenClassException : CurrentClassesFilterException)
 		{
 			/*If the class matches or is a child filter, remember the result and exit the loop.*/
-			if (UKismetMathLibrary::ClassIsChildOf(CurrentActor->GetClass(), CurrenClassException))
+			if (UKismetMathLibrary::ClassIsChildOf(ActorClass, CurrenClassException))
 			{
 				bIsClassesFilterExceptionWorkOut = true;
 				break;
@@ -987,45 +2303,278 @@ bool UTargetSelectionComponent::SortActorByFilters(AActor* CurrentActor)
 		/*If the filter's triggered, get out.*/
 		if (bIsClassesFilterExceptionWorkOut)
 		{
-			return false;
+			bIsPassed = false;
 		}
 	}
 
 	/*If the filter is valid.*/
-	if (bIsValidInterfaceFilter)
+	if (bIsPassed && bIsValidInterfaceFilter)
+	{
+		if (!ActorClass->ImplementsInterface(CurrentInterfaceFilter))
+		{
+			bIsPassed = false;
+		}
+	}
+
+	return bIsPassed;
+}
+
+void UTargetSelectionComponent::FilterActorsInParallel(const TArray<AActor*>& Candidates)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_FilterActorsInParallel);
+
+	/*Compile the profile on the game thread, the workers only read it.*/
+	const FTargetSelectionCompiledFilter* ProfileFilter = nullptr;
+	if (CurrentFilterProfile != nullptr)
+	{
+		ProfileFilter = &CurrentFilterProfile->GetCompiledFilter();
+	}
+
+	/*The workers look for the duplicates, the indices must be ready before.*/
+	SelectionCore.UpdateIndices();
+
+	const int32 NumCandidates = Candidates.Num();
+	const int32 NumChunks = GetNumParallelChunks(NumCandidates);
+	const int32 ChunkSize = FMath::DivideAndRoundUp(NumCandidates, NumChunks);
+
+	if (ParallelChunks.Num() < NumChunks)
+	{
+		ParallelChunks.SetNum(NumChunks);
+	}
+
+	ParallelFor(NumChunks, [this, &Candidates, ProfileFilter, NumCandidates, ChunkSize](int32 ChunkIndex)
+	{
+		FTargetSelectionParallelChunk& Chunk = ParallelChunks[ChunkIndex];
+		Chunk.PassedActors.Reset();
+		Chunk.NewClassVerdicts.Reset();
+
+		const int32 LastIndex = FMath::Min((ChunkIndex + 1) * ChunkSize, NumCandidates);
+		for (int32 Index = ChunkIndex * ChunkSize; Index < LastIndex; Index++)
+		{
+			if (SortActorByFiltersConcurrent(Candidates[Index], ProfileFilter, Chunk))
+			{
+				Chunk.PassedActors.Add(Candidates[Index]);
+			}
+		}
+	});
+
+	/*Merge the chunks in order and remember the new results of the filters.*/
+	for (int32 ChunkIndex = 0; ChunkIndex != NumChunks; ChunkIndex++)
+	{
+		FTargetSelectionParallelChunk& Chunk = ParallelChunks[ChunkIndex];
+		for (AActor* PassedActor : Chunk.PassedActors)
+		{
+			if (CheckLineOfSight(PassedActor))
+			{
+				AddObservedActor(PassedActor);
+			}
+		}
+		for (const auto& Pair : Chunk.NewClassVerdicts)
+		{
+			if (ProfileFilter != nullptr)
+			{
+				ProfileFilter->Verdicts.Add(Pair.Key, Pair.Value);
+			}
+			else
+			{
+				ClassFilterVerdicts.Add(Pair.Key, Pair.Value);
+			}
+		}
+	}
+}
+
+bool UTargetSelectionComponent::SortActorByFiltersConcurrent(AActor* CurrentActor, const FTargetSelectionCompiledFilter* ProfileFilter, FTargetSelectionParallelChunk& Chunk) const
+{
+	if (CurrentActor == nullptr)
 	{
-		if (!UKismetSystemLibrary::DoesImplementInterface(CurrentActor, CurrentInterfaceFilter))
+		return false;
+	}
+
+	/*The indices of SelectionCore are not changed while the workers run.*/
+	if (SelectionCore.Num() > 0 && bIsCheckAddingActorsForDuplicates)
+	{
+		if (SelectionCore.Contains(CurrentActor))
 		{
 			return false;
 		}
 	}
 
-	return true;
+	if (bIsCustomArray)
+	{
+		if (CustomArrayDuplicate.Contains(CurrentActor))
+		{
+			return true;
+		}
+	}
+
+	UClass* ActorClass = CurrentActor->GetClass();
+
+	/*Take the result from the shared cache, then from the cache of the chunk.*/
+	const bool* CachedVerdict = ProfileFilter != nullptr ? ProfileFilter->Verdicts.Find(ActorClass) : ClassFilterVerdicts.Find(ActorClass);
+	if (CachedVerdict == nullptr)
+	{
+		CachedVerdict = Chunk.NewClassVerdicts.Find(ActorClass);
+	}
+	if (CachedVerdict != nullptr)
+	{
+		return *CachedVerdict;
+	}
 
+	const bool bIsPassed = ProfileFilter != nullptr ? ProfileFilter->CheckClassUncached(ActorClass) : CheckClassByFiltersUncached(ActorClass);
+	Chunk.NewClassVerdicts.Add(ActorClass, bIsPassed);
+
+	return bIsPassed;
 }
 
 void UTargetSelectionComponent::SortActorsByDistance()
 {
-	/*The lambda requires a local variable in this method.*/
-	AActor* MyOwner = Owner;
-	/*If the ravener is valid and in the array is more than 1 element.*/
-	if (MyOwner != nullptr && ObservedActorsArr.Num() > 1)
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_SortActorsByDistance);
+	CSV_SCOPED_TIMING_STAT(TargetSelection, SortActorsByDistance);
+
+	/*If the owner is not valid.*/
+	if (Owner == nullptr)
+	{
+		if (bIsDebugMode)
+		{
+			UE_LOG(LogTemp, Error, TEXT("TargetSelection: GetOwner() == nullptr"));
+		}
+		return;
+	}
+
+	const int32 NumActors = SelectionCore.Num();
+
+	SortLocationsX.SetNumUninitialized(NumActors, false);
+	SortLocationsY.SetNumUninitialized(NumActors, false);
+	SortLocationsZ.SetNumUninitialized(NumActors, false);
+	SortDistanceKeys.SetNumUninitialized(NumActors, false);
+
+	/*The locations are read once per frame. Take them from the cache and compute the keys of the range.
+	The squared distance gives the same order as the distance, without the square roots.*/
+	CacheActorLocations();
+	const FVector OwnerLocation = OwnerLocationCache;
+	auto ComputeKeys = [this, OwnerLocation](int32 FirstIndex, int32 LastIndex)
+	{
+		for (int32 Index = FirstIndex; Index < LastIndex; Index++)
+		{
+			const FVector& Location = SelectionCore.GetPosition(Index);
+			SortLocationsX[Index] = Location.X;
+			SortLocationsY[Index] = Location.Y;
+			SortLocationsZ[Index] = Location.Z;
+		}
+		TargetSelectionDistance::ComputeDistancesSquared(
+			SortLocationsX.GetData() + FirstIndex,
+			SortLocationsY.GetData() + FirstIndex,
+			SortLocationsZ.GetData() + FirstIndex,
+			LastIndex - FirstIndex,
+			OwnerLocation,
+			SortDistanceKeys.GetData() + FirstIndex
+		);
+	};
+
+	/*If there are a lot of actors, compute the keys on the worker threads.*/
+	if (ParallelProcessingThreshold > 0 && NumActors >= ParallelProcessingThreshold)
 	{
-		ObservedActorsArr.Sort([MyOwner](const AActor& A, const AActor& B)
+		const int32 NumChunks = GetNumParallelChunks(NumActors);
+		const int32 ChunkSize = FMath::DivideAndRoundUp(NumActors, NumChunks);
+		ParallelFor(NumChunks, [&ComputeKeys, NumActors, ChunkSize](int32 ChunkIndex)
 		{
-			return A.GetDistanceTo(MyOwner) < B.GetDistanceTo(MyOwner);
+			ComputeKeys(ChunkIndex * ChunkSize, FMath::Min((ChunkIndex + 1) * ChunkSize, NumActors));
 		});
 	}
 	else
 	{
-		if (MyOwner == nullptr)
+		ComputeKeys(0, NumActors);
+	}
+
+	/*The observed actor keeps being observed at its new index. With 0 or 1 actor the keys are only cached.*/
+	const FTargetSelectionActorCore::ESortResult SortResult = SelectionCore.Sort(
+		SortDistanceKeys.GetData(), OwnerLocation, NumberOfNearestActorsToOrder, SortMovementThreshold, &GetDistanceSquared);
+
+	if (SortResult == FTargetSelectionActorCore::ESortResult::Skipped)
+	{
+		++NumSkippedSorts;
+		INC_DWORD_STAT(STAT_TargetSelection_NumSortsSkipped);
+	}
+	else if (SortResult == FTargetSelectionActorCore::ESortResult::Sorted)
+	{
+		++NumPerformedSorts;
+		INC_DWORD_STAT_BY(STAT_TargetSelection_NumActorsSorted, NumActors);
+		CSV_CUSTOM_STAT(TargetSelection, ActorsSorted, NumActors, ECsvCustomStatOp::Accumulate);
+	}
+}
+
+FVector UTargetSelectionComponent::GetCachedActorLocation(AActor* Actor) const
+{
+	if (Actor == Owner && Owner != nullptr)
+	{
+		if (ActorLocationsCacheFrame != GFrameCounter)
 		{
-			if (bIsDebugMode)
-			{
-				UE_LOG(LogTemp, Error, TEXT("TargetSelection: GetOwner() == nullptr"));
-			}
+			CacheActorLocations();
 		}
+		return OwnerLocationCache;
 	}
+
+	/*The observed actors are read in one pass with the others.*/
+	const int32 Index = SelectionCore.Find(Actor);
+	if (Index != INDEX_NONE)
+	{
+		CacheActorLocations();
+		return SelectionCore.GetPosition(Index);
+	}
+
+	return Actor->GetActorLocation();
+}
+
+void UTargetSelectionComponent::CacheActorLocations() const
+{
+	if (IsActorLocationsCacheValid())
+	{
+		return;
+	}
+
+	ActorLocationsCacheFrame = GFrameCounter;
+	if (Owner != nullptr)
+	{
+		OwnerLocationCache = Owner->GetActorLocation();
+	}
+
+	SelectionCore.UpdatePositions([](const AActor* CurrentActor)
+	{
+		return CurrentActor != nullptr ? CurrentActor->GetActorLocation() : FVector::ZeroVector;
+	});
+}
+
+void UTargetSelectionComponent::ResetSortCounters()
+{
+	NumSkippedSorts = 0;
+	NumPerformedSorts = 0;
+}
+
+void UTargetSelectionComponent::InsertActorByDistance(AActor* NewActor)
+{
+	/*The distances are cached by the last sort. If the array was changed without sorting, sort it once.*/
+	if (!SelectionCore.IsOrderValid())
+	{
+		SortActorsByDistance();
+	}
+
+	/*Without the owner there is nothing to order by.*/
+	if (!SelectionCore.IsOrderValid())
+	{
+		AddObservedActor(NewActor);
+		return;
+	}
+
+	/*Place the actor among the ordered actors after the ones with the same distance.
+	If it is farther than all of them, it goes to the unordered rest, to the end.*/
+	const FVector NewLocation = NewActor->GetActorLocation();
+	SelectionCore.InsertByKey(NewActor, NewLocation, FVector::DistSquared(NewLocation, GetCachedActorLocation(Owner)));
+}
+
+void UTargetSelectionComponent::AddObservedActor(AActor* NewActor)
+{
+	/*The location is read now if the others are already read in this frame, else it is read with them.*/
+	SelectionCore.Add(NewActor, IsActorLocationsCacheValid() ? NewActor->GetActorLocation() : FVector::ZeroVector);
 }
 
 
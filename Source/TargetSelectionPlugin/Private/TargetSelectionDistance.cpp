@@ -0,0 +1,45 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionDistance.h"
+#include "Math/VectorRegister.h"
+
+
+void TargetSelectionDistance::ComputeDistancesSquared(
+	const float* X,
+	const float* Y,
+	const float* Z,
+	int32 Num,
+	const FVector& Origin,
+	float* OutDistancesSquared
+)
+{
+	const VectorRegister OriginX = VectorSetFloat1(Origin.X);
+	const VectorRegister OriginY = VectorSetFloat1(Origin.Y);
+	const VectorRegister OriginZ = VectorSetFloat1(Origin.Z);
+
+	int32 Index = 0;
+
+	/*Four points at once.*/
+	for (; Index + 4 <= Num; Index += 4)
+	{
+		const VectorRegister DeltaX = VectorSubtract(VectorLoad(X + Index), OriginX);
+		const VectorRegister DeltaY = VectorSubtract(VectorLoad(Y + Index), OriginY);
+		const VectorRegister DeltaZ = VectorSubtract(VectorLoad(Z + Index), OriginZ);
+
+		VectorRegister DistanceSquared = VectorMultiply(DeltaX, DeltaX);
+		DistanceSquared = VectorMultiplyAdd(DeltaY, DeltaY, DistanceSquared);
+		DistanceSquared = VectorMultiplyAdd(DeltaZ, DeltaZ, DistanceSquared);
+
+		VectorStore(DistanceSquared, OutDistancesSquared + Index);
+	}
+
+	/*The rest of the points.*/
+	for (; Index < Num; ++Index)
+	{
+		const float DeltaX = X[Index] - Origin.X;
+		const float DeltaY = Y[Index] - Origin.Y;
+		const float DeltaZ = Z[Index] - Origin.Z;
+		OutDistancesSquared[Index] = DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ;
+	}
+}
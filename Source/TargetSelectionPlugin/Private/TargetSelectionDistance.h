@@ -0,0 +1,25 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*Batch distance math over locations stored as a structure of arrays.*/
+namespace TargetSelectionDistance
+{
+	/*
+	Compute the squared distances from Origin to Num points, four points per vector instruction.
+		@param X, Y, Z Coordinates of the points.
+		@param Num Number of the points.
+		@param Origin The point the distances are measured from.
+		@param OutDistancesSquared Receives Num squared distances.
+	*/
+	void ComputeDistancesSquared(
+		const float* X,
+		const float* Y,
+		const float* Z,
+		int32 Num,
+		const FVector& Origin,
+		float* OutDistancesSquared
+	);
+}
@@ -0,0 +1,121 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionFilterProfile.h"
+#include "GameFramework/Actor.h"
+
+
+bool FTargetSelectionCompiledFilter::CheckClass(const UClass* ActorClass) const
+{
+	/*If the class was checked before, take the result.*/
+	if (const bool* CachedVerdict = Verdicts.Find(ActorClass))
+	{
+		return *CachedVerdict;
+	}
+
+	const bool bIsPassed = CheckClassUncached(ActorClass);
+	Verdicts.Add(ActorClass, bIsPassed);
+
+	return bIsPassed;
+}
+
+bool FTargetSelectionCompiledFilter::CheckClassUncached(const UClass* ActorClass) const
+{
+	if (ActorClass == nullptr)
+	{
+		return false;
+	}
+
+	/*Walk up the ancestry once and look each ancestor up in the sets.*/
+	bool bIsIncluded = IncludeClasses.Num() == 0;
+	for (const UClass* AncestorClass = ActorClass; AncestorClass != nullptr; AncestorClass = AncestorClass->GetSuperClass())
+	{
+		if (ExcludeClasses.Contains(AncestorClass))
+		{
+			return false;
+		}
+		if (!bIsIncluded && IncludeClasses.Contains(AncestorClass))
+		{
+			bIsIncluded = true;
+		}
+	}
+
+	if (!bIsIncluded)
+	{
+		return false;
+	}
+
+	if (InterfaceClass != nullptr && !ActorClass->ImplementsInterface(InterfaceClass))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+void FTargetSelectionCompiledFilter::Reset()
+{
+	IncludeClasses.Reset();
+	ExcludeClasses.Reset();
+	InterfaceClass = nullptr;
+	Verdicts.Reset();
+}
+
+const FTargetSelectionCompiledFilter& UTargetSelectionFilterProfile::GetCompiledFilter()
+{
+	if (!bIsCompiled)
+	{
+		CompileFilter();
+	}
+	return CompiledFilter;
+}
+
+void UTargetSelectionFilterProfile::CompileFilter()
+{
+	CompiledFilter.Reset();
+
+	for (auto& CurrentClass : ClassesFilter)
+	{
+		/*Not valid classes are skipped.*/
+		if (CurrentClass != nullptr && !CurrentClass->IsPendingKill())
+		{
+			CompiledFilter.IncludeClasses.Add(CurrentClass);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: %s: Class in ClassesFilter is not valid, it won't be used."), *GetName());
+		}
+	}
+
+	for (auto& CurrentClassException : ClassesFilterException)
+	{
+		if (CurrentClassException != nullptr && !CurrentClassException->IsPendingKill())
+		{
+			CompiledFilter.ExcludeClasses.Add(CurrentClassException);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TargetSelection: %s: Class in ClassesFilterException is not valid, it won't be used."), *GetName());
+		}
+	}
+
+	CompiledFilter.InterfaceClass = InterfaceFilter;
+
+	bIsCompiled = true;
+}
+
+void UTargetSelectionFilterProfile::PostLoad()
+{
+	Super::PostLoad();
+
+	CompileFilter();
+}
+
+#if WITH_EDITOR
+void UTargetSelectionFilterProfile::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	CompileFilter();
+}
+#endif
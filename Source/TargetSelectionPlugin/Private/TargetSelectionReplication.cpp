@@ -0,0 +1,56 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionReplication.h"
+#include "GameFramework/Actor.h"
+
+
+bool FTargetSelectionReplicatedCandidates::SetCandidates(const TArray<AActor*>& Actors, int32 NumCandidates)
+{
+	bool bIsChanged = false;
+
+	/*The item of every place changes only if another actor took the place.*/
+	for (int32 Index = 0; Index != NumCandidates; Index++)
+	{
+		if (Index < Items.Num())
+		{
+			if (Items[Index].Actor != Actors[Index])
+			{
+				Items[Index].Actor = Actors[Index];
+				MarkItemDirty(Items[Index]);
+				bIsChanged = true;
+			}
+		}
+		else
+		{
+			FTargetSelectionReplicatedCandidate& NewItem = Items[Items.AddDefaulted()];
+			NewItem.Actor = Actors[Index];
+			NewItem.Order = uint8(Index);
+			MarkItemDirty(NewItem);
+			bIsChanged = true;
+		}
+	}
+
+	if (Items.Num() > NumCandidates)
+	{
+		Items.SetNum(NumCandidates);
+		MarkArrayDirty();
+		bIsChanged = true;
+	}
+
+	return bIsChanged;
+}
+
+void FTargetSelectionReplicatedCandidates::GetCandidates(TArray<AActor*>& OutActors, int32 NumCandidates) const
+{
+	/*The removed places may still be in the items if the state came first.*/
+	OutActors.Reset();
+	OutActors.SetNumZeroed(NumCandidates);
+	for (const FTargetSelectionReplicatedCandidate& Item : Items)
+	{
+		if (OutActors.IsValidIndex(Item.Order))
+		{
+			OutActors[Item.Order] = Item.Actor;
+		}
+	}
+}
@@ -0,0 +1,56 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionSnapshot.h"
+#include "HAL/PlatformAtomics.h"
+#include "HAL/PlatformMisc.h"
+
+
+FTargetSelectionSnapshotBuffer::FTargetSelectionSnapshotBuffer()
+{
+	Slots[0].Version = 0;
+	Slots[1].Version = 0;
+	Sequence = 0;
+}
+
+void FTargetSelectionSnapshotBuffer::Publish(const FTargetSelectionSnapshot& NewSnapshot)
+{
+	const int32 NewSequence = Sequence + 1;
+	FSlot& Slot = Slots[NewSequence & 1];
+
+	/*The version is odd while the slot is written. The interlocked operations are full barriers.*/
+	FPlatformAtomics::InterlockedIncrement(&Slot.Version);
+	Slot.Snapshot = NewSnapshot;
+	Slot.Snapshot.Sequence = uint32(NewSequence);
+	FPlatformAtomics::InterlockedIncrement(&Slot.Version);
+
+	FPlatformAtomics::InterlockedExchange(&Sequence, NewSequence);
+}
+
+void FTargetSelectionSnapshotBuffer::Read(FTargetSelectionSnapshot& OutSnapshot) const
+{
+	for (;;)
+	{
+		const FSlot& Slot = Slots[FPlatformAtomics::AtomicRead(&Sequence) & 1];
+
+		const int32 VersionBefore = FPlatformAtomics::AtomicRead(&Slot.Version);
+		if (VersionBefore & 1)
+		{
+			continue;
+		}
+
+		OutSnapshot = Slot.Snapshot;
+
+		/*The copy must be complete before the version is read again.*/
+		FPlatformMisc::MemoryBarrier();
+		if (FPlatformAtomics::AtomicRead(&Slot.Version) == VersionBefore)
+		{
+			return;
+		}
+	}
+}
+
+uint32 FTargetSelectionSnapshotBuffer::GetSequence() const
+{
+	return uint32(FPlatformAtomics::AtomicRead(&Sequence));
+}
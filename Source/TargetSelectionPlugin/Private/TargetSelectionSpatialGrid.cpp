@@ -0,0 +1,173 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionSpatialGrid.h"
+#include "GameFramework/Actor.h"
+
+
+FTargetSelectionSpatialGrid::FTargetSelectionSpatialGrid()
+{
+	CellSize = 500.f;
+	InvCellSize = 1.f / CellSize;
+}
+
+void FTargetSelectionSpatialGrid::SetCellSize(float InCellSize)
+{
+	if (InCellSize <= KINDA_SMALL_NUMBER || InCellSize == CellSize)
+	{
+		return;
+	}
+
+	CellSize = InCellSize;
+	InvCellSize = 1.f / CellSize;
+
+	/*Rehash the actors into the cells of the new size.*/
+	Cells.Reset();
+	for (auto& Pair : Entries)
+	{
+		Pair.Value.Cell = GetCell(Pair.Value.Location);
+		Cells.FindOrAdd(Pair.Value.Cell).Add(const_cast<AActor*>(Pair.Key));
+	}
+}
+
+void FTargetSelectionSpatialGrid::AddActor(AActor* Actor, const FVector& Location)
+{
+	if (Actor == nullptr)
+	{
+		return;
+	}
+
+	if (Entries.Contains(Actor))
+	{
+		UpdateActor(Actor, Location);
+		return;
+	}
+
+	FEntry& NewEntry = Entries.Add(Actor);
+	NewEntry.Cell = GetCell(Location);
+	NewEntry.Location = Location;
+	Cells.FindOrAdd(NewEntry.Cell).Add(Actor);
+}
+
+void FTargetSelectionSpatialGrid::RemoveActor(AActor* Actor)
+{
+	FEntry RemovedEntry;
+	if (Entries.RemoveAndCopyValue(Actor, RemovedEntry))
+	{
+		RemoveFromCell(Actor, RemovedEntry.Cell);
+	}
+}
+
+void FTargetSelectionSpatialGrid::UpdateActor(AActor* Actor, const FVector& Location)
+{
+	FEntry* CurrentEntry = Entries.Find(Actor);
+	if (CurrentEntry == nullptr)
+	{
+		return;
+	}
+
+	CurrentEntry->Location = Location;
+
+	const FIntVector NewCell = GetCell(Location);
+	/*The actor stays in the same cell, nothing to rehash.*/
+	if (NewCell == CurrentEntry->Cell)
+	{
+		return;
+	}
+
+	RemoveFromCell(Actor, CurrentEntry->Cell);
+	CurrentEntry->Cell = NewCell;
+	Cells.FindOrAdd(NewCell).Add(Actor);
+}
+
+void FTargetSelectionSpatialGrid::QueryRadius(const FVector& Origin, float Radius, TArray<AActor*>& OutActors) const
+{
+	if (Entries.Num() == 0 || Radius < 0.f)
+	{
+		return;
+	}
+
+	const float RadiusSquared = Radius * Radius;
+	const FIntVector MinCell = GetCell(Origin - FVector(Radius));
+	const FIntVector MaxCell = GetCell(Origin + FVector(Radius));
+
+	const int64 NumCellsInBox =
+		int64(MaxCell.X - MinCell.X + 1) *
+		int64(MaxCell.Y - MinCell.Y + 1) *
+		int64(MaxCell.Z - MinCell.Z + 1);
+
+	/*If the sphere covers more cells than the grid has, it is cheaper to scan the occupied cells.*/
+	if (NumCellsInBox > Cells.Num())
+	{
+		for (const auto& Pair : Cells)
+		{
+			const FIntVector& Cell = Pair.Key;
+			if (Cell.X < MinCell.X || Cell.X > MaxCell.X
+				|| Cell.Y < MinCell.Y || Cell.Y > MaxCell.Y
+				|| Cell.Z < MinCell.Z || Cell.Z > MaxCell.Z)
+			{
+				continue;
+			}
+			for (AActor* CurrentActor : Pair.Value)
+			{
+				if (FVector::DistSquared(Entries.FindChecked(CurrentActor).Location, Origin) <= RadiusSquared)
+				{
+					OutActors.Add(CurrentActor);
+				}
+			}
+		}
+		return;
+	}
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+			{
+				const TArray<AActor*>* CellActors = Cells.Find(FIntVector(X, Y, Z));
+				if (CellActors == nullptr)
+				{
+					continue;
+				}
+				for (AActor* CurrentActor : *CellActors)
+				{
+					if (FVector::DistSquared(Entries.FindChecked(CurrentActor).Location, Origin) <= RadiusSquared)
+					{
+						OutActors.Add(CurrentActor);
+					}
+				}
+			}
+		}
+	}
+}
+
+void FTargetSelectionSpatialGrid::Empty()
+{
+	Cells.Empty();
+	Entries.Empty();
+}
+
+FIntVector FTargetSelectionSpatialGrid::GetCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X * InvCellSize),
+		FMath::FloorToInt(Location.Y * InvCellSize),
+		FMath::FloorToInt(Location.Z * InvCellSize)
+	);
+}
+
+void FTargetSelectionSpatialGrid::RemoveFromCell(AActor* Actor, const FIntVector& Cell)
+{
+	TArray<AActor*>* CellActors = Cells.Find(Cell);
+	if (CellActors == nullptr)
+	{
+		return;
+	}
+
+	CellActors->RemoveSingleSwap(Actor, false);
+	if (CellActors->Num() == 0)
+	{
+		Cells.Remove(Cell);
+	}
+}
@@ -0,0 +1,9 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+/*Stats of the plugin. Shown by the "stat TargetSelection" console command.*/
+DECLARE_STATS_GROUP(TEXT("TargetSelection"), STATGROUP_TargetSelection, STATCAT_Advanced);
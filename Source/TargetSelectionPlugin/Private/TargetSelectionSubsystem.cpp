@@ -0,0 +1,363 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionSubsystem.h"
+#include "TargetSelectionFilterProfile.h"
+#include "TargetSelectionStats.h"
+#include "TargetSelectionComponent.h"
+#include "GameFramework/Actor.h"
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "Engine/NetConnection.h"
+
+DECLARE_CYCLE_STAT(TEXT("QueryTargetableActors"), STAT_TargetSelection_QueryTargetableActors, STATGROUP_TargetSelection);
+DECLARE_CYCLE_STAT(TEXT("UpdateTargetableActors"), STAT_TargetSelection_UpdateTargetableActors, STATGROUP_TargetSelection);
+DECLARE_CYCLE_STAT(TEXT("ProcessSwitchRequests"), STAT_TargetSelection_ProcessSwitchRequests, STATGROUP_TargetSelection);
+DECLARE_CYCLE_STAT(TEXT("UpdateAutoTargetingComponents"), STAT_TargetSelection_UpdateAutoTargetingComponents, STATGROUP_TargetSelection);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Auto-targeting updates"), STAT_TargetSelection_NumAutoTargetingUpdates, STATGROUP_TargetSelection);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Switch requests rejected"), STAT_TargetSelection_NumSwitchRequestsRejected, STATGROUP_TargetSelection);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Registered actors"), STAT_TargetSelection_NumRegisteredActors, STATGROUP_TargetSelection);
+
+void UTargetSelectionSubsystem::RegisterTargetableActor(AActor* TargetableActor)
+{
+	if (TargetableActor == nullptr || TargetableActor->IsPendingKill())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("TargetSelection: RegisterTargetableActor(): TargetableActor is not valid."));
+		return;
+	}
+
+	if (const int32* FoundIndex = RegisteredActorsIndices.Find(TargetableActor))
+	{
+		/*The memory of a destroyed actor may be reused by the new one before the update forgets it.*/
+		RegisteredActors[*FoundIndex].Actor = TargetableActor;
+		TargetableActorsGrid.UpdateActor(TargetableActor, TargetableActor->GetActorLocation());
+		return;
+	}
+
+	FRegisteredActor NewRegisteredActor;
+	NewRegisteredActor.Actor = TargetableActor;
+	NewRegisteredActor.Key = TargetableActor;
+	RegisteredActorsIndices.Add(TargetableActor, RegisteredActors.Add(NewRegisteredActor));
+
+	TargetableActorsGrid.AddActor(TargetableActor, TargetableActor->GetActorLocation());
+}
+
+void UTargetSelectionSubsystem::UnregisterTargetableActor(AActor* TargetableActor)
+{
+	if (const int32* FoundIndex = RegisteredActorsIndices.Find(TargetableActor))
+	{
+		RemoveRegisteredActorAt(*FoundIndex);
+	}
+}
+
+void UTargetSelectionSubsystem::QueryTargetableActors(FVector Origin, float Radius, UTargetSelectionFilterProfile* FilterProfile, TArray<AActor*>& OutActors)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_QueryTargetableActors);
+
+	const int32 FirstNewIndex = OutActors.Num();
+	TargetableActorsGrid.QueryRadius(Origin, Radius, OutActors);
+
+	const FTargetSelectionCompiledFilter* Filter = FilterProfile != nullptr ? &FilterProfile->GetCompiledFilter() : nullptr;
+
+	/*Skip the actors destroyed since the last update and the actors that didn't pass the filters.*/
+	int32 WriteIndex = FirstNewIndex;
+	for (int32 ReadIndex = FirstNewIndex; ReadIndex != OutActors.Num(); ReadIndex++)
+	{
+		AActor* FoundActor = OutActors[ReadIndex];
+		if (!RegisteredActors[RegisteredActorsIndices.FindChecked(FoundActor)].Actor.IsValid())
+		{
+			continue;
+		}
+		if (Filter != nullptr && !Filter->CheckClass(FoundActor->GetClass()))
+		{
+			continue;
+		}
+		OutActors[WriteIndex++] = FoundActor;
+	}
+	OutActors.SetNum(WriteIndex, false);
+}
+
+void UTargetSelectionSubsystem::SetCellSize(float CellSize)
+{
+	TargetableActorsGrid.SetCellSize(CellSize);
+}
+
+void UTargetSelectionSubsystem::QueueSwitchRequest(UTargetSelectionComponent* Component, AActor* RequestedActor)
+{
+	if (Component == nullptr || RequestedActor == nullptr)
+	{
+		return;
+	}
+
+	/*The spamming connections are cut off before any check.*/
+	AActor* ComponentOwner = Component->GetOwner();
+	if (!ConsumeSwitchRequestBudget(ComponentOwner != nullptr ? ComponentOwner->GetNetConnection() : nullptr))
+	{
+		INC_DWORD_STAT(STAT_TargetSelection_NumSwitchRequestsRejected);
+		return;
+	}
+
+	FSwitchRequest NewRequest;
+	NewRequest.Component = Component;
+	NewRequest.RequestedActor = RequestedActor;
+	PendingSwitchRequests.Add(NewRequest);
+}
+
+void UTargetSelectionSubsystem::SetSwitchRequestRateLimit(float RequestsPerSecond, int32 MaxBurst)
+{
+	SwitchRequestsPerSecond = FMath::Max(RequestsPerSecond, 0.f);
+	MaxSwitchRequestBurst = FMath::Max(MaxBurst, 1);
+}
+
+bool UTargetSelectionSubsystem::ConsumeSwitchRequestBudget(UNetConnection* Connection)
+{
+	/*The requests of the server itself are not limited.*/
+	if (Connection == nullptr)
+	{
+		return true;
+	}
+
+	const float CurrentTime = GetWorld()->GetRealTimeSeconds();
+	FSwitchRequestBudget* Budget = SwitchRequestBudgets.Find(Connection);
+	if (Budget == nullptr)
+	{
+		Budget = &SwitchRequestBudgets.Add(Connection);
+		Budget->Connection = Connection;
+		Budget->NumRequests = float(MaxSwitchRequestBurst);
+		Budget->LastTime = CurrentTime;
+	}
+
+	/*The budget is refilled with the time.*/
+	Budget->NumRequests = FMath::Min(Budget->NumRequests + (CurrentTime - Budget->LastTime) * SwitchRequestsPerSecond, float(MaxSwitchRequestBurst));
+	Budget->LastTime = CurrentTime;
+	if (Budget->NumRequests < 1.f)
+	{
+		return false;
+	}
+	Budget->NumRequests -= 1.f;
+	return true;
+}
+
+void UTargetSelectionSubsystem::ProcessSwitchRequests()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_ProcessSwitchRequests);
+
+	/*Only the last request of every component matters, the earlier ones are skipped.*/
+	ProcessedSwitchComponents.Reset();
+	for (int32 Index = PendingSwitchRequests.Num() - 1; Index >= 0; Index--)
+	{
+		const FSwitchRequest& Request = PendingSwitchRequests[Index];
+		UTargetSelectionComponent* Component = Request.Component.Get();
+		AActor* RequestedActor = Request.RequestedActor.Get();
+		if (Component == nullptr || RequestedActor == nullptr)
+		{
+			continue;
+		}
+
+		bool bIsAlreadyProcessed = false;
+		ProcessedSwitchComponents.Add(Component, &bIsAlreadyProcessed);
+		if (bIsAlreadyProcessed)
+		{
+			continue;
+		}
+
+		/*The location is taken from the grid read in this frame, the actors not registered are read here.*/
+		const FVector* FoundLocation = TargetableActorsGrid.FindLocation(RequestedActor);
+		const FVector RequestedActorLocation = FoundLocation != nullptr ? *FoundLocation : RequestedActor->GetActorLocation();
+
+		if (Component->IsSwitchRequestValid(RequestedActor, RequestedActorLocation))
+		{
+			if (Component->GetObservedActor() != RequestedActor)
+			{
+				Component->SetObservedActorByPointer(RequestedActor);
+			}
+		}
+		else
+		{
+			INC_DWORD_STAT(STAT_TargetSelection_NumSwitchRequestsRejected);
+		}
+	}
+	PendingSwitchRequests.Reset();
+
+	/*Forget the closed connections.*/
+	for (auto It = SwitchRequestBudgets.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().Connection.IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void UTargetSelectionSubsystem::RegisterAutoTargetingComponent(UTargetSelectionComponent* Component)
+{
+	if (Component != nullptr)
+	{
+		AutoTargetingComponents.AddUnique(Component);
+	}
+}
+
+void UTargetSelectionSubsystem::UnregisterAutoTargetingComponent(UTargetSelectionComponent* Component)
+{
+	AutoTargetingComponents.RemoveSingleSwap(Component, false);
+}
+
+void UTargetSelectionSubsystem::SetMaxAutoTargetingUpdatesPerFrame(int32 MaxUpdates)
+{
+	MaxAutoTargetingUpdatesPerFrame = FMath::Max(MaxUpdates, 1);
+}
+
+void UTargetSelectionSubsystem::UpdateAutoTargetingComponents()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_UpdateAutoTargetingComponents);
+
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+
+	/*Every component is checked no more than once per frame. The components removed by the updates shorten the array.*/
+	int32 NumChecked = 0;
+	int32 NumUpdated = 0;
+	while (NumChecked < AutoTargetingComponents.Num() && NumUpdated < MaxAutoTargetingUpdatesPerFrame)
+	{
+		if (NextAutoTargetingIndex >= AutoTargetingComponents.Num())
+		{
+			NextAutoTargetingIndex = 0;
+		}
+
+		UTargetSelectionComponent* Component = AutoTargetingComponents[NextAutoTargetingIndex].Get();
+		if (Component == nullptr)
+		{
+			AutoTargetingComponents.RemoveAtSwap(NextAutoTargetingIndex, 1, false);
+			continue;
+		}
+		++NextAutoTargetingIndex;
+		++NumChecked;
+
+		if (Component->IsAutoTargetingDue(CurrentTime))
+		{
+			Component->UpdateAutoTargeting(CurrentTime);
+			++NumUpdated;
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_TargetSelection_NumAutoTargetingUpdates, NumUpdated);
+}
+
+void UTargetSelectionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	FWorldDelegates::OnWorldCleanup.AddUObject(this, &UTargetSelectionSubsystem::OnWorldCleanup);
+}
+
+void UTargetSelectionSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldCleanup.RemoveAll(this);
+	EmptyRegistry();
+
+	Super::Deinitialize();
+}
+
+UWorld* UTargetSelectionSubsystem::GetWorld() const
+{
+	const UGameInstance* GameInstance = GetGameInstance();
+	return GameInstance != nullptr ? GameInstance->GetWorld() : nullptr;
+}
+
+void UTargetSelectionSubsystem::OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+{
+	/*The game instance outlives its worlds, the actors of the old world must not be queried in the new one.*/
+	if (World != nullptr && World == GetWorld())
+	{
+		EmptyRegistry();
+	}
+}
+
+void UTargetSelectionSubsystem::EmptyRegistry()
+{
+	RegisteredActors.Empty();
+	RegisteredActorsIndices.Empty();
+	TargetableActorsGrid.Empty();
+	PendingSwitchRequests.Empty();
+	SwitchRequestBudgets.Empty();
+	AutoTargetingComponents.Empty();
+	NextAutoTargetingIndex = 0;
+}
+
+void UTargetSelectionSubsystem::Tick(float DeltaTime)
+{
+	/*The game instance may be between the worlds.*/
+	if (GetWorld() == nullptr)
+	{
+		return;
+	}
+
+	UpdateTargetableActors();
+
+	/*The requests are checked after the locations are read.*/
+	if (PendingSwitchRequests.Num() > 0)
+	{
+		ProcessSwitchRequests();
+	}
+
+	/*The auto-targeting sorts by the locations of this frame too.*/
+	if (AutoTargetingComponents.Num() > 0)
+	{
+		UpdateAutoTargetingComponents();
+	}
+}
+
+ETickableTickType UTargetSelectionSubsystem::GetTickableTickType() const
+{
+	/*The default object never ticks.*/
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UTargetSelectionSubsystem::IsTickable() const
+{
+	return RegisteredActors.Num() > 0 || PendingSwitchRequests.Num() > 0 || AutoTargetingComponents.Num() > 0;
+}
+
+UWorld* UTargetSelectionSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+TStatId UTargetSelectionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTargetSelectionSubsystem, STATGROUP_Tickables);
+}
+
+void UTargetSelectionSubsystem::UpdateTargetableActors()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TargetSelection_UpdateTargetableActors);
+
+	for (int32 Index = RegisteredActors.Num() - 1; Index >= 0; Index--)
+	{
+		AActor* RegisteredActor = RegisteredActors[Index].Actor.Get();
+		if (RegisteredActor == nullptr)
+		{
+			RemoveRegisteredActorAt(Index);
+			continue;
+		}
+
+		/*The actor changes the cell only if it crossed the cell border.*/
+		TargetableActorsGrid.UpdateActor(RegisteredActors[Index].Key, RegisteredActor->GetActorLocation());
+	}
+
+	SET_DWORD_STAT(STAT_TargetSelection_NumRegisteredActors, RegisteredActors.Num());
+}
+
+void UTargetSelectionSubsystem::RemoveRegisteredActorAt(int32 Index)
+{
+	AActor* RemovingKey = RegisteredActors[Index].Key;
+
+	TargetableActorsGrid.RemoveActor(RemovingKey);
+	RegisteredActorsIndices.Remove(RemovingKey);
+
+	/*The last actor takes the place of the removed one.*/
+	RegisteredActors.RemoveAtSwap(Index, 1, false);
+	if (RegisteredActors.IsValidIndex(Index))
+	{
+		RegisteredActorsIndices.Add(RegisteredActors[Index].Key, Index);
+	}
+}
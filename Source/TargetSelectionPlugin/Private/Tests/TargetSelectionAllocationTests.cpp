@@ -0,0 +1,269 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionTestWorld.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "GameFramework/Actor.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformMisc.h"
+#include "InputCoreTypes.h"
+
+namespace TargetSelectionAllocationTests
+{
+	/*
+	Counts the heap allocations of the game thread while it is set as GMalloc. The memory is taken from the previous GMalloc,
+	so the blocks can be freed after the counter is removed. The barriers publish the swap of GMalloc to the other threads
+	before the counted code runs and after it ends.
+	*/
+	class FCountingMalloc : public FMalloc
+	{
+	public:
+
+		FCountingMalloc()
+			: InnerMalloc(GMalloc)
+			, NumAllocations(0)
+		{
+			FPlatformMisc::MemoryBarrier();
+			GMalloc = this;
+			FPlatformMisc::MemoryBarrier();
+		}
+
+		virtual ~FCountingMalloc()
+		{
+			FPlatformMisc::MemoryBarrier();
+			GMalloc = InnerMalloc;
+			FPlatformMisc::MemoryBarrier();
+		}
+
+		int32 GetNumAllocations() const { return NumAllocations; };
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return InnerMalloc->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			if (Count > 0)
+			{
+				CountAllocation();
+			}
+			return InnerMalloc->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override
+		{
+			InnerMalloc->Free(Original);
+		}
+
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+		{
+			return InnerMalloc->QuantizeSize(Count, Alignment);
+		}
+
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return InnerMalloc->GetAllocationSize(Original, SizeOut);
+		}
+
+		virtual void SetupTLSCachesOnCurrentThread() override
+		{
+			InnerMalloc->SetupTLSCachesOnCurrentThread();
+		}
+
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+		{
+			InnerMalloc->ClearAndDisableTLSCachesOnCurrentThread();
+		}
+
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return InnerMalloc->IsInternallyThreadSafe();
+		}
+
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return TEXT("TargetSelectionCountingMalloc");
+		}
+
+	private:
+
+		/*
+		The other threads of the engine, for example the render thread, allocate on their own and are not counted.
+		The component is set to do all its work on the game thread, so nothing of it is missed.
+		*/
+		void CountAllocation()
+		{
+			if (IsInGameThread())
+			{
+				++NumAllocations;
+			}
+		}
+
+		FMalloc* InnerMalloc;
+
+		int32 NumAllocations;
+	};
+
+	/*The settings of the component in one case.*/
+	struct FSortFlags
+	{
+		const TCHAR* Name;
+		bool bIsSortAlways;
+		bool bIsInsertInOrder;
+	};
+
+	const FSortFlags SortFlagsCases[] =
+	{
+		{ TEXT("Default"), false, false },
+		{ TEXT("SortAlways"), true, false },
+		{ TEXT("SortAlways_InsertInOrder"), true, true },
+	};
+
+	const int32 NumActors = 1000;
+
+	const int32 NumOperations = 10000;
+
+	/*The actors that are not observed yet. The add takes one of them, the remove gives one back.*/
+	const int32 NumOutsideActors = 16;
+
+	const float WatchingRadius = 5000.f;
+
+	/*Number of the calls of the accessor that returns a copy of the array.*/
+	const int32 NumCopyingPolls = 100;
+
+	/*Read the selection by the accessors that don't copy, as a widget does every frame.*/
+	int32 PollAccessors(const UTargetSelectionComponent& Component)
+	{
+		int32 NumReadActors = 0;
+		for (int32 Index = 0; Index != Component.GetNumObservedActors(); Index++)
+		{
+			if (Component.GetObservedActorAt(Index) != nullptr)
+			{
+				++NumReadActors;
+			}
+		}
+		for (AActor* CurrentActor : Component.GetObservedActors())
+		{
+			if (CurrentActor == Component.GetObservedActor())
+			{
+				++NumReadActors;
+			}
+		}
+		return NumReadActors;
+	}
+
+	/*
+	One operation of the steady state: the switch, the add or the remove of the observed actor with the switch, then the poll of the selection.
+	Returns the result of the poll.
+	*/
+	int32 RunOperation(UTargetSelectionComponent& Component, int32 OperationIndex, TArray<AActor*>& OutsideActors)
+	{
+		switch (OperationIndex % 3)
+		{
+		case 0:
+			FTargetSelectionComponentTestAccess::SwitchCurrentActors(Component);
+			break;
+		case 1:
+			Component.AddActor(OutsideActors.Pop(false));
+			break;
+		default:
+			AActor* RemovingActor = Component.GetObservedActor();
+			Component.RemoveAndSwitchActors(RemovingActor);
+			OutsideActors.Add(RemovingActor);
+			break;
+		}
+
+		/*Every operation is a new frame for the per-frame caches.*/
+		++GFrameCounter;
+
+		return PollAccessors(Component);
+	}
+}
+
+/*
+The switch, the add, the remove and the zero-copy accessors allocate nothing on the game thread in the steady state.
+The allocations of the other threads are not counted, the parallel processing of the component is turned off for the test.
+Every poll of GetObservedActorsArr() allocates one copy of the array.
+*/
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTargetSelectionZeroAllocationTest, "TargetSelection.Allocations.GameThread.SwitchAddRemovePoll",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FTargetSelectionZeroAllocationTest::RunTest(const FString& Parameters)
+{
+	using namespace TargetSelectionAllocationTests;
+
+	TArray<TSubclassOf<AActor>> ClassesFilter;
+	TArray<TSubclassOf<AActor>> ClassesFilterException;
+
+	for (const FSortFlags& SortFlags : SortFlagsCases)
+	{
+		FTargetSelectionTestWorld TestWorld;
+		UTargetSelectionComponent* Component = TestWorld.SpawnSelector(FVector::ZeroVector, WatchingRadius, [&SortFlags](UTargetSelectionComponent& NewComponent)
+		{
+			NewComponent.bIsSortArrayOfActors_WhenSwitch = SortFlags.bIsSortAlways;
+			NewComponent.bIsSortArrayOfActors_WhenAddNew = SortFlags.bIsSortAlways;
+			NewComponent.bIsSortArrayOfActors_WhenRemove = SortFlags.bIsSortAlways;
+			NewComponent.bIsInsertNewActorsInOrder = SortFlags.bIsInsertInOrder;
+
+			/*All the work is done on the game thread, where the allocations are counted.*/
+			NewComponent.ParallelProcessingThreshold = NumActors + NumOutsideActors + 1;
+		});
+
+		TArray<AActor*> Targets;
+		TestWorld.SpawnTargets(NumActors, FVector::ZeroVector, WatchingRadius * 0.9f, Targets);
+
+		/*Outside the collision, so WatchActors doesn't take them.*/
+		TArray<AActor*> OutsideActors;
+		TestWorld.SpawnTargets(NumOutsideActors, FVector(WatchingRadius * 4.f, 0.f, 0.f), WatchingRadius * 0.5f, OutsideActors);
+
+		Component->WatchActors(ClassesFilter, ClassesFilterException, nullptr, EKeys::SpaceBar);
+		if (!TestEqual(TEXT("All the targets are observed"), Component->GetObservedActors().Num(), NumActors))
+		{
+			return false;
+		}
+
+		/*The buffers and the caches of the classes grow on the first operations.*/
+		for (int32 Index = 0; Index != NumOutsideActors * 6; Index++)
+		{
+			RunOperation(*Component, Index, OutsideActors);
+		}
+
+		int32 NumAllocations = 0;
+		int32 NumPolledActors = 0;
+		{
+			FCountingMalloc CountingMalloc;
+			for (int32 Index = 0; Index != NumOperations; Index++)
+			{
+				NumPolledActors += RunOperation(*Component, Index, OutsideActors);
+			}
+			NumAllocations = CountingMalloc.GetNumAllocations();
+		}
+
+		TestEqual(FString::Printf(TEXT("%s: the heap allocations of the game thread in %d operations"), SortFlags.Name, NumOperations), NumAllocations, 0);
+		TestTrue(FString::Printf(TEXT("%s: the accessors see the observed actors"), SortFlags.Name), NumPolledActors > 0);
+
+		/*The copy of the array is the only allocation of the polling by value.*/
+		int32 NumCopyingAllocations = 0;
+		int32 NumCopiedActors = 0;
+		{
+			FCountingMalloc CountingMalloc;
+			for (int32 Index = 0; Index != NumCopyingPolls; Index++)
+			{
+				NumCopiedActors += Component->GetObservedActorsArr().Num();
+			}
+			NumCopyingAllocations = CountingMalloc.GetNumAllocations();
+		}
+
+		TestEqual(FString::Printf(TEXT("%s: the heap allocations of %d polls of GetObservedActorsArr()"), SortFlags.Name, NumCopyingPolls), NumCopyingAllocations, NumCopyingPolls);
+		TestEqual(FString::Printf(TEXT("%s: the polls of GetObservedActorsArr() copy all the actors"), SortFlags.Name), NumCopiedActors, NumCopyingPolls * NumActors);
+		TestEqual(FString::Printf(TEXT("%s: the number of the observed actors is kept"), SortFlags.Name), Component->GetObservedActors().Num(), NumActors);
+	}
+
+	return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,158 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionTestWorld.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "GameFramework/Actor.h"
+#include "HAL/PlatformTime.h"
+#include "InputCoreTypes.h"
+
+/*
+Run headless with:
+UE4Editor-Cmd <Project>.uproject -ExecCmds="Automation RunTests TargetSelection.Performance; Quit" -nullrhi -unattended -nopause
+Every repeat is counted as a new frame (++GFrameCounter), so the per-frame caches of the component are read again as in the game.
+*/
+namespace TargetSelectionPerfTests
+{
+	/*The sort flags of the component in one case.*/
+	struct FSortFlags
+	{
+		const TCHAR* Name;
+		bool bIsWhenBegin;
+		bool bIsWhenSwitch;
+		bool bIsWhenAddNew;
+		bool bIsWhenRemove;
+		bool bIsInsertInOrder;
+	};
+
+	const FSortFlags SortFlagsCases[] =
+	{
+		{ TEXT("NoSort"), false, false, false, false, false },
+		{ TEXT("SortWhenBegin"), true, false, false, false, false },
+		{ TEXT("SortAlways"), true, true, true, true, false },
+		{ TEXT("SortAlways_InsertInOrder"), true, true, true, true, true },
+	};
+
+	const int32 NumActorsCases[] = { 10, 100, 1000, 10000, 50000 };
+
+	/*Radius of the collision of the selector. The targets are spawned inside it.*/
+	const float WatchingRadius = 5000.f;
+
+	/*The cheap operations are repeated more, so every case takes about the same time.*/
+	int32 GetNumRepeats(int32 NumActors, int32 Budget, int32 MaxRepeats)
+	{
+		return FMath::Clamp(Budget / NumActors, 1, MaxRepeats);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTargetSelectionComponentPerfTest, "TargetSelection.Performance.Component",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FTargetSelectionComponentPerfTest::RunTest(const FString& Parameters)
+{
+	using namespace TargetSelectionPerfTests;
+
+	FTargetSelectionPerfReport Report(TEXT("ComponentPerformance"));
+	TArray<TSubclassOf<AActor>> ClassesFilter;
+	TArray<TSubclassOf<AActor>> ClassesFilterException;
+	const FKey InputKey = EKeys::SpaceBar;
+
+	for (const int32 NumActors : NumActorsCases)
+	{
+		FTargetSelectionTestWorld TestWorld;
+		UTargetSelectionComponent* Component = TestWorld.SpawnSelector(FVector::ZeroVector, WatchingRadius, [](UTargetSelectionComponent&) {});
+		AActor* Selector = Component->GetOwner();
+
+		TArray<AActor*> Targets;
+		TestWorld.SpawnTargets(NumActors, FVector::ZeroVector, WatchingRadius * 0.9f, Targets);
+
+		/*The added actors are outside the collision, so WatchActors doesn't take them.*/
+		const int32 NumExtraActors = GetNumRepeats(NumActors, 100000, 1000);
+		TArray<AActor*> ExtraActors;
+		TestWorld.SpawnTargets(NumExtraActors, FVector(WatchingRadius * 4.f, 0.f, 0.f), WatchingRadius * 0.5f, ExtraActors);
+
+		for (const FSortFlags& SortFlags : SortFlagsCases)
+		{
+			Component->bIsSortArrayOfActors_WhenBegin = SortFlags.bIsWhenBegin;
+			Component->bIsSortArrayOfActors_WhenSwitch = SortFlags.bIsWhenSwitch;
+			Component->bIsSortArrayOfActors_WhenAddNew = SortFlags.bIsWhenAddNew;
+			Component->bIsSortArrayOfActors_WhenRemove = SortFlags.bIsWhenRemove;
+			Component->bIsInsertNewActorsInOrder = SortFlags.bIsInsertInOrder;
+			Selector->SetActorLocation(FVector::ZeroVector);
+
+			/*The overlaps are taken, filtered and sorted from the beginning.*/
+			const int32 NumWatches = GetNumRepeats(NumActors, 100000, 50);
+			double Seconds = 0.0;
+			for (int32 Index = 0; Index != NumWatches; Index++)
+			{
+				Component->OffWatchingActors();
+				++GFrameCounter;
+				const double StartTime = FPlatformTime::Seconds();
+				Component->WatchActors(ClassesFilter, ClassesFilterException, nullptr, InputKey);
+				Seconds += FPlatformTime::Seconds() - StartTime;
+			}
+			if (!TestEqual(TEXT("All the targets are observed"), Component->GetObservedActors().Num(), NumActors))
+			{
+				return false;
+			}
+			Report.Add(TEXT("WatchActors"), SortFlags.Name, NumActors, NumWatches, Seconds);
+
+			const int32 NumSwitches = GetNumRepeats(NumActors, 1000000, 1000);
+			Seconds = 0.0;
+			for (int32 Index = 0; Index != NumSwitches; Index++)
+			{
+				++GFrameCounter;
+				const double StartTime = FPlatformTime::Seconds();
+				FTargetSelectionComponentTestAccess::SwitchCurrentActors(*Component);
+				Seconds += FPlatformTime::Seconds() - StartTime;
+			}
+			Report.Add(TEXT("SwitchCurrentActors"), SortFlags.Name, NumActors, NumSwitches, Seconds);
+
+			Seconds = 0.0;
+			for (AActor* ExtraActor : ExtraActors)
+			{
+				++GFrameCounter;
+				const double StartTime = FPlatformTime::Seconds();
+				Component->AddActor(ExtraActor);
+				Seconds += FPlatformTime::Seconds() - StartTime;
+			}
+			TestEqual(TEXT("The extra actors are added"), Component->GetObservedActors().Num(), NumActors + NumExtraActors);
+			Report.Add(TEXT("AddActor"), SortFlags.Name, NumActors, NumExtraActors, Seconds);
+
+			/*The observed actor is removed every time, so every call switches.*/
+			Seconds = 0.0;
+			for (int32 Index = 0; Index != NumExtraActors; Index++)
+			{
+				++GFrameCounter;
+				AActor* RemovingActor = Component->GetObservedActor();
+				const double StartTime = FPlatformTime::Seconds();
+				Component->RemoveAndSwitchActors(RemovingActor);
+				Seconds += FPlatformTime::Seconds() - StartTime;
+			}
+			TestEqual(TEXT("The observed actors are removed"), Component->GetObservedActors().Num(), NumActors);
+			Report.Add(TEXT("RemoveAndSwitchActors"), SortFlags.Name, NumActors, NumExtraActors, Seconds);
+
+			/*The owner walks, so the order changes a little between the sorts.*/
+			const int32 NumSorts = GetNumRepeats(NumActors, 1000000, 200);
+			Seconds = 0.0;
+			for (int32 Index = 0; Index != NumSorts; Index++)
+			{
+				Selector->SetActorLocation(FVector(Index * 10.f, 0.f, 0.f));
+				++GFrameCounter;
+				const double StartTime = FPlatformTime::Seconds();
+				FTargetSelectionComponentTestAccess::SortActorsByDistance(*Component);
+				Seconds += FPlatformTime::Seconds() - StartTime;
+			}
+			Report.Add(TEXT("SortActorsByDistance"), SortFlags.Name, NumActors, NumSorts, Seconds);
+
+			Component->OffWatchingActors();
+		}
+	}
+
+	TestTrue(TEXT("The results are written"), Report.Save());
+	return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
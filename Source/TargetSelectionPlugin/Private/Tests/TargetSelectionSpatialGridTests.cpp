@@ -0,0 +1,132 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionTestWorld.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "TargetSelectionSpatialGrid.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Components/SphereComponent.h"
+#include "HAL/PlatformTime.h"
+
+/*
+Compare the spatial grid with the physics the component takes the candidates from without it.
+Half of the targets are in the radius, the other half are far away, so every way finds the same actors.
+*/
+namespace TargetSelectionSpatialGridTests
+{
+	const int32 NumActorsCases[] = { 100, 1000, 10000 };
+
+	/*The default radius of TargetSelectionCollision.*/
+	const float WatchingRadius = 1000.f;
+
+	/*The default cell size of the registry.*/
+	const float CellSize = 500.f;
+
+	int32 GetNumRepeats(int32 NumActors)
+	{
+		return FMath::Clamp(100000 / NumActors, 10, 1000);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTargetSelectionSpatialGridPerfTest, "TargetSelection.Performance.SpatialGrid",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FTargetSelectionSpatialGridPerfTest::RunTest(const FString& Parameters)
+{
+	using namespace TargetSelectionSpatialGridTests;
+
+	FTargetSelectionPerfReport Report(TEXT("SpatialGridPerformance"));
+	TArray<AActor*> FoundActors;
+	TArray<FOverlapResult> Overlaps;
+
+	for (const int32 NumActors : NumActorsCases)
+	{
+		FTargetSelectionTestWorld TestWorld;
+		UWorld* World = TestWorld.GetWorld();
+		UTargetSelectionComponent* Component = TestWorld.SpawnSelector(FVector::ZeroVector, WatchingRadius, [](UTargetSelectionComponent&) {});
+		AActor* Selector = Component->GetOwner();
+
+		TArray<AActor*> Targets;
+		TestWorld.SpawnTargets(NumActors / 2, FVector::ZeroVector, WatchingRadius * 0.9f, Targets);
+		TestWorld.SpawnTargets(NumActors - NumActors / 2, FVector(WatchingRadius * 20.f, 0.f, 0.f), WatchingRadius * 10.f, Targets);
+
+		FTargetSelectionSpatialGrid Grid;
+		Grid.SetCellSize(CellSize);
+		for (AActor* Target : Targets)
+		{
+			Grid.AddActor(Target, Target->GetActorLocation());
+		}
+
+		const int32 NumRepeats = GetNumRepeats(NumActors);
+		const FString Flags = FString::Printf(TEXT("Radius%.0f"), WatchingRadius);
+
+		/*The current path: the overlaps tracked by the collision.*/
+		double Seconds = 0.0;
+		for (int32 Index = 0; Index != NumRepeats; Index++)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			Component->GetTargetSelectionCollision()->GetOverlappingActors(FoundActors);
+			Seconds += FPlatformTime::Seconds() - StartTime;
+		}
+		const int32 NumOverlappingActors = FoundActors.Num();
+		Report.Add(TEXT("GetOverlappingActors"), Flags, NumActors, NumRepeats, Seconds);
+
+		/*The query of the physics scene, as the component does without the collision.*/
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(TargetSelectionSpatialGridTest), false, Selector);
+		Seconds = 0.0;
+		for (int32 Index = 0; Index != NumRepeats; Index++)
+		{
+			Overlaps.Reset();
+			const double StartTime = FPlatformTime::Seconds();
+			World->OverlapMultiByObjectType(Overlaps, FVector::ZeroVector, FQuat::Identity,
+				FCollisionObjectQueryParams(ECC_WorldDynamic), FCollisionShape::MakeSphere(WatchingRadius), QueryParams);
+			Seconds += FPlatformTime::Seconds() - StartTime;
+		}
+		Report.Add(TEXT("OverlapMultiByObjectType"), Flags, NumActors, NumRepeats, Seconds);
+
+		Seconds = 0.0;
+		for (int32 Index = 0; Index != NumRepeats; Index++)
+		{
+			FoundActors.Reset();
+			const double StartTime = FPlatformTime::Seconds();
+			Grid.QueryRadius(FVector::ZeroVector, WatchingRadius, FoundActors);
+			Seconds += FPlatformTime::Seconds() - StartTime;
+		}
+		Report.Add(TEXT("SpatialGridQueryRadius"), Flags, NumActors, NumRepeats, Seconds);
+
+		TestEqual(TEXT("The collision overlaps the targets in the radius"), NumOverlappingActors, NumActors / 2);
+		TestEqual(TEXT("The grid finds the targets in the radius"), FoundActors.Num(), NumActors / 2);
+
+		/*The upkeep: every target moves a little, the grid is updated by the registry, the physics by the components.*/
+		const int32 NumMoves = FMath::Max(NumRepeats / 10, 1);
+		double GridSeconds = 0.0;
+		Seconds = 0.0;
+		for (int32 Index = 0; Index != NumMoves; Index++)
+		{
+			const FVector Offset(Index % 2 == 0 ? 10.f : -10.f, 0.f, 0.f);
+			double StartTime = FPlatformTime::Seconds();
+			for (AActor* Target : Targets)
+			{
+				Target->SetActorLocation(Target->GetActorLocation() + Offset);
+			}
+			Seconds += FPlatformTime::Seconds() - StartTime;
+
+			StartTime = FPlatformTime::Seconds();
+			for (AActor* Target : Targets)
+			{
+				Grid.UpdateActor(Target, Target->GetActorLocation());
+			}
+			GridSeconds += FPlatformTime::Seconds() - StartTime;
+		}
+		Report.Add(TEXT("MoveTargetsWithOverlaps"), Flags, NumActors, NumMoves, Seconds);
+		Report.Add(TEXT("SpatialGridUpdateActors"), Flags, NumActors, NumMoves, GridSeconds);
+	}
+
+	TestTrue(TEXT("The results are written"), Report.Save());
+	return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,148 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+
+#include "TargetSelectionTestWorld.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/WorldSettings.h"
+#include "Components/SphereComponent.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectGlobals.h"
+
+
+FTargetSelectionTestWorld::FTargetSelectionTestWorld()
+{
+	NumSpawnedTargets = 0;
+
+	World = UWorld::CreateWorld(EWorldType::Game, false);
+	World->AddToRoot();
+
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	FURL URL;
+	World->InitializeActorsForPlay(URL);
+	World->BeginPlay();
+
+	/*Without the game mode nothing begins play, so the world settings begin it.*/
+	if (!World->HasBegunPlay())
+	{
+		World->GetWorldSettings()->NotifyBeginPlay();
+	}
+}
+
+FTargetSelectionTestWorld::~FTargetSelectionTestWorld()
+{
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	World->RemoveFromRoot();
+
+	/*The next world of the test doesn't share the memory with the actors of this one.*/
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+AActor* FTargetSelectionTestWorld::SpawnTarget(const FVector& Location)
+{
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AActor* Target = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParameters);
+
+	/*The targets overlap the collision of the selector (ECC_Pawn) and ignore each other.*/
+	USphereComponent* TargetCollision = NewObject<USphereComponent>(Target, TEXT("TargetCollision"));
+	TargetCollision->InitSphereRadius(50.f);
+	TargetCollision->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+	TargetCollision->SetCollisionObjectType(ECC_WorldDynamic);
+	TargetCollision->SetCollisionResponseToAllChannels(ECR_Ignore);
+	TargetCollision->SetCollisionResponseToChannel(ECC_Pawn, ECR_Overlap);
+	TargetCollision->SetGenerateOverlapEvents(true);
+	TargetCollision->SetWorldLocation(Location);
+	Target->SetRootComponent(TargetCollision);
+	TargetCollision->RegisterComponent();
+
+	++NumSpawnedTargets;
+	return Target;
+}
+
+void FTargetSelectionTestWorld::SpawnTargets(int32 NumTargets, const FVector& Origin, float Radius, TArray<AActor*>& OutTargets)
+{
+	FRandomStream RandomStream(NumSpawnedTargets);
+	OutTargets.Reserve(OutTargets.Num() + NumTargets);
+	for (int32 Index = 0; Index != NumTargets; Index++)
+	{
+		OutTargets.Add(SpawnTarget(Origin + RandomStream.GetUnitVector() * RandomStream.FRandRange(0.f, Radius)));
+	}
+}
+
+UTargetSelectionComponent* FTargetSelectionTestWorld::SpawnSelector(const FVector& Location, float Radius, TFunctionRef<void(UTargetSelectionComponent&)> SetUp)
+{
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AActor* Selector = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParameters);
+
+	/*The root must exist before the component, its collision is attached to the root in the constructor.*/
+	USceneComponent* Root = NewObject<USceneComponent>(Selector, TEXT("Root"));
+	Root->SetWorldLocation(Location);
+	Selector->SetRootComponent(Root);
+	Root->RegisterComponent();
+
+	UTargetSelectionComponent* Component = NewObject<UTargetSelectionComponent>(Selector, TEXT("TargetSelection"));
+	Component->GetTargetSelectionCollision()->SetSphereRadius(Radius);
+	SetUp(*Component);
+
+	/*The component and its collision are registered and begin play, the actor already did.*/
+	Selector->RegisterAllComponents();
+	return Component;
+}
+
+FTargetSelectionPerfReport::FTargetSelectionPerfReport(const FString& InName)
+	: Name(InName)
+{
+}
+
+void FTargetSelectionPerfReport::Add(const FString& Case, const FString& Flags, int32 NumActors, int32 NumRepeats, double Seconds)
+{
+	FTargetSelectionPerfResult NewResult;
+	NewResult.Case = Case;
+	NewResult.Flags = Flags;
+	NewResult.NumActors = NumActors;
+	NewResult.NumRepeats = NumRepeats;
+	NewResult.Seconds = Seconds;
+	Results.Add(NewResult);
+
+	UE_LOG(LogTemp, Display, TEXT("TargetSelection: %s: %s, %s, %d actors: %.3f us per call."),
+		*Name, *Case, *Flags, NumActors, NumRepeats > 0 ? Seconds * 1000000.0 / NumRepeats : 0.0);
+}
+
+bool FTargetSelectionPerfReport::Save() const
+{
+	const FString EngineVersion = FEngineVersion::Current().ToString();
+	const FString Platform = FPlatformProperties::IniPlatformName();
+
+	FString Csv = TEXT("engine,platform,case,flags,actors,repeats,total_ms,average_us\n");
+	FString Json = FString::Printf(TEXT("{\n\t\"name\": \"%s\",\n\t\"engine\": \"%s\",\n\t\"platform\": \"%s\",\n\t\"results\": [\n"), *Name, *EngineVersion, *Platform);
+	for (int32 Index = 0; Index != Results.Num(); Index++)
+	{
+		const FTargetSelectionPerfResult& Result = Results[Index];
+		const double AverageMicroseconds = Result.NumRepeats > 0 ? Result.Seconds * 1000000.0 / Result.NumRepeats : 0.0;
+
+		Csv += FString::Printf(TEXT("%s,%s,%s,%s,%d,%d,%.4f,%.4f\n"),
+			*EngineVersion, *Platform, *Result.Case, *Result.Flags, Result.NumActors, Result.NumRepeats, Result.Seconds * 1000.0, AverageMicroseconds);
+		Json += FString::Printf(TEXT("\t\t{ \"case\": \"%s\", \"flags\": \"%s\", \"actors\": %d, \"repeats\": %d, \"total_ms\": %.4f, \"average_us\": %.4f }%s\n"),
+			*Result.Case, *Result.Flags, Result.NumActors, Result.NumRepeats, Result.Seconds * 1000.0, AverageMicroseconds,
+			Index + 1 != Results.Num() ? TEXT(",") : TEXT(""));
+	}
+	Json += TEXT("\t]\n}\n");
+
+	const FString BasePath = FPaths::Combine(FPaths::AutomationDir(), TEXT("TargetSelection"), Name);
+	const bool bIsCsvSaved = FFileHelper::SaveStringToFile(Csv, *(BasePath + TEXT(".csv")));
+	const bool bIsJsonSaved = FFileHelper::SaveStringToFile(Json, *(BasePath + TEXT(".json")));
+	return bIsCsvSaved && bIsJsonSaved;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
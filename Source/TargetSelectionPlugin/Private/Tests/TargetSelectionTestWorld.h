@@ -0,0 +1,107 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "TargetSelectionComponent.h"
+
+class AActor;
+class UWorld;
+
+/*Calls the private methods of UTargetSelectionComponent in the tests.*/
+struct FTargetSelectionComponentTestAccess
+{
+	static bool SwitchCurrentActors(UTargetSelectionComponent& Component) { return Component.SwitchCurrentActors(); };
+
+	static void SortActorsByDistance(UTargetSelectionComponent& Component) { Component.SortActorsByDistance(); };
+};
+
+/*
+Game world of the tests. It is begun play without a game mode and destroyed with the object.
+The targets are actors with the overlapping sphere as the root, they overlap the collision of the selector but not each other.
+*/
+class FTargetSelectionTestWorld
+{
+public:
+
+	FTargetSelectionTestWorld();
+
+	~FTargetSelectionTestWorld();
+
+	UWorld* GetWorld() const { return World; };
+
+	/*Spawn the target at the location.*/
+	AActor* SpawnTarget(const FVector& Location);
+
+	/*
+	Spawn the targets at the random locations inside the sphere. The locations are the same in every run.
+		@param NumTargets Number of the targets.
+		@param Origin Center of the sphere.
+		@param Radius Radius of the sphere.
+		@param OutTargets The spawned targets are appended to this array.
+	*/
+	void SpawnTargets(int32 NumTargets, const FVector& Origin, float Radius, TArray<AActor*>& OutTargets);
+
+	/*
+	Spawn the owner with UTargetSelectionComponent. The component begins play with the settings made by SetUp.
+		@param Location Location of the owner.
+		@param Radius Radius of TargetSelectionCollision.
+		@param SetUp Changes the settings of the component before BeginPlay.
+	*/
+	UTargetSelectionComponent* SpawnSelector(const FVector& Location, float Radius, TFunctionRef<void(UTargetSelectionComponent&)> SetUp);
+
+private:
+
+	UWorld* World;
+
+	/*Number of the spawned targets, the seed of the next random location.*/
+	int32 NumSpawnedTargets;
+};
+
+/*One measured case of the performance tests.*/
+struct FTargetSelectionPerfResult
+{
+	/*The measured operation.*/
+	FString Case;
+
+	/*The settings of the component.*/
+	FString Flags;
+
+	int32 NumActors = 0;
+
+	int32 NumRepeats = 0;
+
+	/*Time of all repeats.*/
+	double Seconds = 0.0;
+};
+
+/*
+Results of the performance tests, written to <Project>/Saved/Automation/TargetSelection/<Name>.csv and <Name>.json.
+Every line has the version of the engine, so the files of the different engines can be compared.
+*/
+class FTargetSelectionPerfReport
+{
+public:
+
+	explicit FTargetSelectionPerfReport(const FString& InName);
+
+	/*Add the result of the case.*/
+	void Add(const FString& Case, const FString& Flags, int32 NumActors, int32 NumRepeats, double Seconds);
+
+	/*Write the results to the files. Returns false if a file is not written.*/
+	bool Save() const;
+
+	const TArray<FTargetSelectionPerfResult>& GetResults() const { return Results; };
+
+private:
+
+	FString Name;
+
+	TArray<FTargetSelectionPerfResult> Results;
+};
+
+#endif //WITH_DEV_AUTOMATION_TESTS
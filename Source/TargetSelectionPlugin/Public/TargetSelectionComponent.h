@@ -5,9 +5,70 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "InputCoreTypes.h"
+#include "UObject/ObjectKey.h"
+#include "TargetSelectionCore.h"
+#include "TargetSelectionSnapshot.h"
+#include "TargetSelectionReplication.h"
 #include "TargetSelectionComponent.generated.h"
 
 class USphereComponent;
+class UPrimitiveComponent;
+class UTargetSelectionFilterProfile;
+class UTargetSelectionSubsystem;
+struct FTargetSelectionCompiledFilter;
+struct FTargetSelectionAsyncJob;
+struct FOverlapDatum;
+struct FTraceHandle;
+struct FTraceDatum;
+
+/*The containers of the engine for TTargetSelectionCore, so the array of the observed actors is a TArray that can be given out without copying.*/
+struct FTargetSelectionEngineContainers
+{
+	template <typename ElementType>
+	using TArrayType = TArray<ElementType>;
+
+	template <typename KeyType, typename ValueType>
+	using TMapType = TMap<KeyType, ValueType>;
+};
+
+/*The observed actors of the component with the observed one, ordered by the distance to the owner.*/
+using FTargetSelectionActorCore = TTargetSelectionCore<AActor*, FVector, FTargetSelectionEngineContainers>;
+
+/*How the observer interfaces are called for the actors of a class.*/
+struct FTargetSelectionObserverDispatch
+{
+	/*Does the class implement ITargetSelectionNativeInterface?*/
+	bool bIsImplementsNativeInterface = false;
+
+	/*Does the class implement TargetSelectionInterface?*/
+	bool bIsImplementsInterface = false;
+};
+
+/*Visibility of an actor from the owner found by the line of sight trace.*/
+struct FTargetSelectionVisibility
+{
+	/*To find out that the actor is destroyed.*/
+	TWeakObjectPtr<AActor> Actor;
+
+	/*Time of the last check. Negative if the actor was never checked.*/
+	float CheckTime = -1.f;
+
+	/*Is nothing between the owner and the actor?*/
+	bool bIsVisible = true;
+
+	/*Is the trace requested and the result not received yet?*/
+	bool bIsTracePending = false;
+};
+
+/*Buffers of one chunk of the parallel filtering.*/
+struct FTargetSelectionParallelChunk
+{
+	/*The actors that passed the filters, in the order of the candidates.*/
+	TArray<AActor*> PassedActors;
+
+	/*Results of the filters for the classes that were not in the cache.*/
+	TMap<UClass*, bool> NewClassVerdicts;
+};
 
 /*A dispatcher called up when you enable or disable observation.
 	@param bIsEnableTargetSelection On or off.
@@ -19,12 +80,26 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnStateOfTargetSelection, bool, bIs
 */
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnSwitchActorS, AActor*, ObservedActorNow);
 
+/*A dispatcher that is called up once after AddActors() or RemoveActors() changed the array of observed actors.
+	@param NumAddedActors How many actors were added.
+	@param NumRemovedActors How many actors were removed.
+*/
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnObservedActorsChanged, int32, NumAddedActors, int32, NumRemovedActors);
+
+/*A dispatcher that is called up on the clients when the replicated selection of the server came.
+	@param ReplicatedObservedActor The actor being watched on the server.
+*/
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnReplicatedSelectionChanged, AActor*, ReplicatedObservedActor);
+
 
 UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
 class TARGETSELECTIONPLUGIN_API UTargetSelectionComponent : public UActorComponent
 {
 	GENERATED_BODY()
 
+	/*Calls the private methods in the automation tests.*/
+	friend struct FTargetSelectionComponentTestAccess;
+
 public:
 	// Sets default values for this component's properties
 	UTargetSelectionComponent();
@@ -47,6 +122,27 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent")
 		bool bIsSortArrayOfActors_WhenAddNew;
 
+	/*
+	If bIsSortArrayOfActors_WhenAddNew == true, do you want to insert the new actor at its place by the distances cached by the last sort
+	instead of sorting the whole array? The index of the observed actor follows the actor.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent")
+		bool bIsInsertNewActorsInOrder;
+
+	/*
+	How many nearest actors are kept ordered by the sorts. The rest of the array stays unordered, and switching cycles only through the nearest ones.
+	It is cheaper than the full sort if only a few nearest actors matter. 0 sorts and cycles through the whole array.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent", meta = (ClampMin = "0"))
+		int32 NumberOfNearestActorsToOrder;
+
+	/*
+	The distance the owner or an actor must move since the last sort to sort the array again. If nothing moved farther, the sort is skipped,
+	and if only a few actors moved, they are moved to their places in the almost sorted array. 0 sorts the whole array every time.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent", meta = (ClampMin = "0.0"))
+		float SortMovementThreshold;
+
 	/*Do you want to switch to the first actor in the array when the observed one remove? If false, switch to the next actor in the array.*/
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent")
 		bool bIsSwitchToFirstActor_WhenRemoveObservedActor;
@@ -70,6 +166,137 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent")
 		bool bIsCheckAddingActorsForDuplicates;
 
+	/*
+	Do you take the actors from the spatial grid of the world registry (UTargetSelectionSubsystem) instead of the overlaps of TargetSelectionCollision?
+	The actors must be registered in the registry. The radius of TargetSelectionCollision is used for the query.
+	TargetSelectionCollision doesn't collide at all. Must be set before BeginPlay.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionComponent")
+		bool bIsUseSpatialGrid;
+
+	/*
+	Do you want TargetSelectionCollision to overlap only the object channel of the targets (TargetableChannel)?
+	The collision gets its own object type (SelectorChannel), and the other objects in the radius are not tracked by the physics at all.
+	The targets must have the object type TargetableChannel and overlap SelectorChannel. Must be set before BeginPlay.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionComponent")
+		bool bIsUseTargetableChannel;
+
+	/*The object channel of the targets, for example a custom "Targetable" channel of the project. Used if bIsUseTargetableChannel == true.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionComponent")
+		TEnumAsByte<ECollisionChannel> TargetableChannel;
+
+	/*
+	The object channel of TargetSelectionCollision, for example a custom "TargetSelector" channel of the project. Used if bIsUseTargetableChannel == true.
+	Must differ from TargetableChannel, otherwise the collisions of the other components of this kind are overlapped as targets.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionComponent")
+		TEnumAsByte<ECollisionChannel> SelectorChannel;
+
+	/*
+	Do you want the overlap events of TargetSelectionCollision to keep the candidates and call AddActor() and RemoveAndSwitchActors()?
+	Then the observation begins with the kept candidates instead of asking the physics for the overlaps. Must be set before BeginPlay.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionComponent")
+		bool bIsUpdateActorsByOverlaps;
+
+	/*
+	Do you want to work without TargetSelectionCollision? If it is set in the defaults, the collision is never registered and gets no physics state,
+	otherwise it is destroyed at BeginPlay. The actors are found by the async overlap query when the observation begins, and only they are the candidates.
+	The first actor is observed on the next frame. Must be set before BeginPlay.
+	With bIsUseSpatialGrid == true the spatial grid is queried instead.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionComponent|OverlapQuery")
+		bool bIsUseOverlapQuery;
+
+	/*Radius of the query. Used if bIsUseOverlapQuery == true.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|OverlapQuery", meta = (ClampMin = "0"))
+		float OverlapQueryRadius;
+
+	/*The object types found by the query. If it is empty, all object types are found. With bIsUseTargetableChannel == true only TargetableChannel is found.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|OverlapQuery")
+		TArray<TEnumAsByte<EObjectTypeQuery>> OverlapQueryObjectTypes;
+
+	/*
+	Number of the actors from which the filtering and the distances are computed in parallel on the worker threads.
+	The result is the same as on the game thread. 0 disables the parallel processing.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent", meta = (ClampMin = "0"))
+		int32 ParallelProcessingThreshold;
+
+	/*
+	Do you want to take, filter and sort the actors on the task graph when the observation begins?
+	The game thread only copies the candidates, the first actor is observed on the next frame.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent")
+		bool bIsUseAsyncWatching;
+
+	/*
+	Do you want to exclude the actors hidden from the owner by obstacles? The visibility is found by the async line traces from the eyes of the owner.
+	The actors not checked yet are observed until the result of their trace comes on the next frame. Changed at runtime by SetIsCheckLineOfSight().
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionComponent|LineOfSight")
+		bool bIsCheckLineOfSight;
+
+	/*The channel of the line of sight traces.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|LineOfSight")
+		TEnumAsByte<ECollisionChannel> LineOfSightChannel;
+
+	/*How long the found visibility of an actor is used before it is traced again, in seconds.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|LineOfSight", meta = (ClampMin = "0.0"))
+		float LineOfSightCacheLifetime;
+
+	/*The largest number of the line of sight traces per frame. The rest of the actors are traced on the next frames.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|LineOfSight", meta = (ClampMin = "1"))
+		int32 MaxLineOfSightTracesPerFrame;
+
+	/*Do you consider the actors rendered recently visible without the trace? Useful if the owner is the pawn of the local player.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|LineOfSight")
+		bool bIsRecentlyRenderedVisible;
+
+	/*
+	Do you want to replicate the observed actor and the first candidates of the server to the clients?
+	Only the changes are sent. Must be set before BeginPlay.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionComponent|Replication")
+		bool bIsReplicateSelection;
+
+	/*
+	Do you want the clients to ask the server to observe the actors (ServerRequestObservedActor, ServerRequestObservedIndex)?
+	The server RPCs of a component reach the server only if the component is replicated, so it is replicated if this or bIsReplicateSelection is true. Must be set before BeginPlay.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionComponent|Replication")
+		bool bIsAcceptSwitchRequests;
+
+	/*How many first actors of the ordered array are replicated as the candidates.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|Replication", meta = (ClampMin = "0", ClampMax = "255"))
+		int32 MaxReplicatedCandidates;
+
+	/*
+	Do you want to switch to the nearest actor automatically while the observation is on? The actors are taken again and sorted
+	every AutoTargetingInterval..AutoTargetingMaxInterval seconds, depending on the significance of the owner.
+	If all the actors leave, the filters are kept and the observation begins again when the candidates appear, until OffWatchingActors() is called.
+	The updates are spread over the frames by the world registry (UTargetSelectionSubsystem).
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionComponent|AutoTargeting")
+		bool bIsAutoTargeting;
+
+	/*Seconds between the updates of the most significant owner.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|AutoTargeting", meta = (ClampMin = "0"))
+		float AutoTargetingInterval;
+
+	/*Seconds between the updates of the least significant owner.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|AutoTargeting", meta = (ClampMin = "0"))
+		float AutoTargetingMaxInterval;
+
+	/*Distance from the view of the local player at which the owner becomes the least significant. 0 disables the distance check.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|AutoTargeting", meta = (ClampMin = "0"))
+		float AutoTargetingSignificanceDistance;
+
+	/*The significance of the owner that was not rendered recently is multiplied by this value.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TargetSelectionComponent|AutoTargeting", meta = (ClampMin = "0", ClampMax = "1"))
+		float AutoTargetingOffScreenSignificance;
+
 	/*Declare the dispatcher to be called up when the observation is turned on or off.*/
 	UPROPERTY(BlueprintAssignable, Category = "TargetSelectionComponent")
 		FOnStateOfTargetSelection OnStateOfTargetSelection;
@@ -78,20 +305,16 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = "TargetSelectionComponent")
 		FOnSwitchActorS OnSwitchActor;
 
-private:
-	/*The actor currently being observed.*/
-	UPROPERTY(BlueprintGetter = GetObservedActor, Category = "TargetSelectionComponent")
-		AActor* ObservedActor;
-
-	/*Index of the currently observed ObservedActor actor in the ObservedActorsArr array.*/
-	UPROPERTY(BlueprintGetter = GetIndexOfCurrentObservedActor, Category = "TargetSelectionComponent")
-		int32 IndexOfCurrentObservedActor;
+	/*Declare the dispatcher to be called when AddActors() or RemoveActors() changed the array of observed actors.*/
+	UPROPERTY(BlueprintAssignable, Category = "TargetSelectionComponent")
+		FOnObservedActorsChanged OnObservedActorsChanged;
 
-	/*An array of actors that can be observed.*/
-	UPROPERTY(BlueprintGetter = GetObservedActorsArr, Category = "TargetSelectionComponent")
-		TArray<AActor*> ObservedActorsArr;
+	/*Declare the dispatcher to be called on the clients when the replicated selection changed.*/
+	UPROPERTY(BlueprintAssignable, Category = "TargetSelectionComponent|Replication")
+		FOnReplicatedSelectionChanged OnReplicatedSelectionChanged;
 
-	/*Collision for actor observation.*/
+private:
+	/*Collision for actor observation. It is nullptr after BeginPlay if bIsUseOverlapQuery == true.*/
 	UPROPERTY(EditAnywhere, BlueprintGetter = GetTargetSelectionCollision, Category = "TargetSelectionComponent")
 		USphereComponent* TargetSelectionCollision;
 
@@ -103,6 +326,26 @@ private:
 	UPROPERTY(BlueprintGetter = GetIsCustomArray, Category = "TargetSelectionComponent")
 		bool bIsCustomArray;
 
+	/*The filter profile used instead of the current filters. Set by WatchActors_FilterProfile().*/
+	UPROPERTY(BlueprintGetter = GetCurrentFilterProfile, Category = "TargetSelectionComponent")
+		UTargetSelectionFilterProfile* CurrentFilterProfile;
+
+	/*Number of the sorts skipped because nothing moved farther than SortMovementThreshold.*/
+	UPROPERTY(BlueprintGetter = GetNumSkippedSorts, Category = "TargetSelectionComponent")
+		int32 NumSkippedSorts;
+
+	/*The observed actor of the server. Used if bIsReplicateSelection == true.*/
+	UPROPERTY(ReplicatedUsing = OnRep_ReplicatedSelection)
+		FTargetSelectionReplicatedState ReplicatedState;
+
+	/*The first candidates of the server. Used if bIsReplicateSelection == true.*/
+	UPROPERTY(Replicated)
+		FTargetSelectionReplicatedCandidates ReplicatedCandidates;
+
+	/*Number of the sorts performed by SortActorsByDistance().*/
+	UPROPERTY(BlueprintGetter = GetNumPerformedSorts, Category = "TargetSelectionComponent")
+		int32 NumPerformedSorts;
+
 private:
 
 	/*The current array of references to actor classes to be observed.*/
@@ -124,15 +367,89 @@ private:
 	/*Is the interface filter valid?*/
 	bool bIsValidInterfaceFilter;
 
+	/*Results of the filters by class and interface for the classes already checked. Cleared when the filters change.*/
+	TMap<UClass*, bool> ClassFilterVerdicts;
+
 
 	/*Component owner.*/
 	AActor* Owner;
 
-	/*Copy of the outside array of actors.
+	/*The actors of the outside array.
 	Used if	bIsCustomArray == true.
 	Used in SortActorByFilters() when checking if an actor was in an input outside array.
 	*/
-	TArray<AActor*> CustomArrayDuplicate;
+	TSet<AActor*> CustomArrayDuplicate;
+
+	/*The actors overlapping TargetSelectionCollision kept by the overlap events. Used if bIsUpdateActorsByOverlaps == true.*/
+	TSet<AActor*> OverlappedCandidates;
+
+	/*The actors found by the last overlap query. Used if bIsUseOverlapQuery == true.*/
+	TSet<AActor*> OverlapQueryActors;
+
+	/*Is the overlap query sent and its result not taken yet?*/
+	bool bIsOverlapQueryPending;
+
+	/*Number of the last overlap query. The results of the forgotten queries have the other numbers.*/
+	uint32 OverlapQuerySequence;
+
+	/*World time of the next auto-targeting update.*/
+	float NextAutoTargetingTime;
+
+	/*All the actors left the auto-targeting. The filters and the input key are kept, the observation begins again when the candidates appear.*/
+	bool bIsAutoTargetingIdle;
+
+	/*Buffer of GetAvailableActors() and StartAsyncWatching(). The candidates before filtering.*/
+	TArray<AActor*> CandidateActorsBuffer;
+
+	/*
+	The actors that can be observed in the order of switching, the observed one and their locations read in the frame ActorLocationsCacheFrame.
+	Not a property, the actors are reported to the garbage collector by AddReferencedObjects().
+	*/
+	FTargetSelectionActorCore SelectionCore;
+
+	/*Buffer of RemoveActors() and RefreshObservedActors(). The actors to remove that are in the array.*/
+	TSet<AActor*> RemovingActorsBuffer;
+
+	/*Buffers of SortActorsByDistance(). Locations of the observed actors as a structure of arrays.*/
+	TArray<float> SortLocationsX;
+	TArray<float> SortLocationsY;
+	TArray<float> SortLocationsZ;
+
+	/*Buffer of SortActorsByDistance(). Squared distances to the owner.*/
+	TArray<float> SortDistanceKeys;
+
+	/*Buffers of the chunks of FilterActorsInParallel().*/
+	TArray<FTargetSelectionParallelChunk> ParallelChunks;
+
+	/*
+	How the observer interfaces are called, by the classes of the actors. Kept for the lifetime of the component, the filters don't change it.
+	The keys are not references: a class collected and replaced at the same address, for example by a hot reload, has another key.
+	*/
+	TMap<FObjectKey, FTargetSelectionObserverDispatch> ObserverDispatches;
+
+	/*Location of the owner read in the frame ActorLocationsCacheFrame.*/
+	mutable FVector OwnerLocationCache;
+
+	/*Number of the frame the locations were read in. MAX_uint64 if the locations of the array are not read yet.*/
+	mutable uint64 ActorLocationsCacheFrame;
+
+	/*Visibility of the actors found by the line of sight traces. Used if bIsCheckLineOfSight == true.*/
+	TMap<AActor*, FTargetSelectionVisibility> LineOfSightCache;
+
+	/*Number of the line of sight traces requested in the frame LineOfSightTraceFrame.*/
+	int32 NumLineOfSightTraces;
+
+	/*Number of the frame NumLineOfSightTraces is counted in.*/
+	uint64 LineOfSightTraceFrame;
+
+	/*The snapshots of the selection for the other threads. Published by NotifySelectionChanged().*/
+	FTargetSelectionSnapshotBuffer SelectionSnapshots;
+
+	/*The job started by StartAsyncWatching() and not applied yet.*/
+	TSharedPtr<FTargetSelectionAsyncJob, ESPMode::ThreadSafe> PendingAsyncJob;
+
+	/*Number of the current watch request. Increases when the job is cancelled or the outside array is taken, so an older job has the other number.*/
+	uint32 AsyncWatchSequence;
 
 public:
 
@@ -173,6 +490,25 @@ public:
 			FKey InputKey
 		);
 
+	/*Watching the new actors. Version with outside array that is moved into the component instead of copying.
+		@param CustomArray is an outside array. It is left empty if the observation begins with it.
+		@param IputKey Key pressed when observation is enabled. Allows you to set up observation of different actors by pressing different keys.
+	*/
+	void WatchActors_CustomArray(TArray<AActor*>&& CustomArray, FKey InputKey);
+
+	/*
+	Watching the new actors. Version with the filter profile. The filters of the profile are compiled once,
+	so switching between the profiles doesn't check and copy the filters.
+	Must be triggered by pressing the observation key.
+	@param FilterProfile The profile with the filters by class and interface.
+	@param IputKey Key pressed when observation is enabled. Allows you to set up observation of different actors by pressing different keys.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent")
+		void WatchActors_FilterProfile(
+			UTargetSelectionFilterProfile* FilterProfile,
+			FKey InputKey
+		);
+
 	/*Turn off the observation. Must be triggered by pressing the disable observation key.*/
 	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent")
 		void OffWatchingActors();
@@ -191,22 +527,131 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent")
 		void AddActor(AActor* NewActor);
 
+	/*
+		Add several actors to the array at once. The actors are filtered in one pass, the array is sorted once at most
+		and OnObservedActorsChanged is called once.
+		@param NewActors The actors that came into collision.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent")
+		void AddActors(const TArray<AActor*>& NewActors);
+
+	/*
+		Remove several actors from the array at once. The array is sorted once at most, the observed actor is switched once at most
+		and OnObservedActorsChanged is called once.
+		@param RemovingActors The actors that left the collision.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent")
+		void RemoveActors(const TArray<AActor*>& RemovingActors);
+
 	/*Get a pointer to the observed actor.*/
-	UFUNCTION(BlueprintGetter, Category = "TargetSelectionComponent")
-		AActor* GetObservedActor() const { return ObservedActor; };
+	UFUNCTION(BlueprintPure, Category = "TargetSelectionComponent")
+		AActor* GetObservedActor() const { return SelectionCore.GetObserved(); };
 
-	/*Get index of the currently observed ObservedActor actor in the ObservedActorsArr array.*/
-	UFUNCTION(BlueprintGetter, Category = "TargetSelectionComponent")
-		int32 GetIndexOfCurrentObservedActor() { return IndexOfCurrentObservedActor; };
+	/*Get index of the currently observed actor in the array of observed actors. INDEX_NONE if nothing is observed.*/
+	UFUNCTION(BlueprintPure, Category = "TargetSelectionComponent")
+		int32 GetIndexOfCurrentObservedActor() const { return SelectionCore.GetObservedIndex(); };
 
-	/*Get an array of actors that can be observed.*/
-	UFUNCTION(BlueprintGetter, Category = "TargetSelectionComponent")
-		TArray<AActor*> GetObservedActorsArr() { return ObservedActorsArr; };
+	/*Get a copy of the array of actors that can be observed. Every call allocates the copy, GetNumObservedActors() and GetObservedActorAt() don't.*/
+	UFUNCTION(BlueprintPure, Category = "TargetSelectionComponent")
+		TArray<AActor*> GetObservedActorsArr() const { return SelectionCore.GetHandles(); };
+
+	/*Get the number of actors that can be observed.*/
+	UFUNCTION(BlueprintPure, Category = "TargetSelectionComponent")
+		int32 GetNumObservedActors() const { return SelectionCore.Num(); };
+
+	/*Get the actor at the index in the array of actors that can be observed. nullptr if the index is not valid.*/
+	UFUNCTION(BlueprintPure, Category = "TargetSelectionComponent")
+		AActor* GetObservedActorAt(int32 Index) const { return SelectionCore.IsValidIndex(Index) ? SelectionCore.GetHandle(Index) : nullptr; };
+
+	/*
+	Copy the last snapshot of the selection: the observed actor, its index and the first actors of the array with their distances.
+	Can be called on any thread, doesn't lock and doesn't wait for the game thread.
+	*/
+	void GetSelectionSnapshot(FTargetSelectionSnapshot& OutSnapshot) const { SelectionSnapshots.Read(OutSnapshot); };
+
+	/*Get the number of the last snapshot of the selection. Can be called on any thread.*/
+	uint32 GetSelectionSnapshotSequence() const { return SelectionSnapshots.GetSequence(); };
+
+	/*
+	Get the location of the observed actor from the last snapshot of the selection. Returns false if nothing is observed.
+	Can be called on any thread, for example in the animation blueprints. The actor itself is taken by GetObservedActor() on the game thread.
+	*/
+	UFUNCTION(BlueprintPure, Category = "TargetSelectionComponent", meta = (BlueprintThreadSafe))
+		bool GetObservedActorLocation_AnyThread(FVector& OutLocation) const;
+
+	/*
+	Get the location of the actor read once in this frame. All distance computations of the component read it from here.
+	The owner and the observed actors are cached, the other actors are read directly. The actors that move later in the frame are seen where they were at the first read.
+	*/
+	FVector GetCachedActorLocation(AActor* Actor) const;
+
+	/*Get the actor observed on the server. Used if bIsReplicateSelection == true.*/
+	UFUNCTION(BlueprintPure, Category = "TargetSelectionComponent|Replication")
+		AActor* GetReplicatedObservedActor() const { return ReplicatedState.ObservedActor; };
+
+	/*Get the index of the actor observed on the server. Used if bIsReplicateSelection == true.*/
+	UFUNCTION(BlueprintPure, Category = "TargetSelectionComponent|Replication")
+		int32 GetReplicatedIndexOfObservedActor() const { return ReplicatedState.IndexOfObservedActor; };
+
+	/*Get the first candidates of the server in its order. Used if bIsReplicateSelection == true.*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent|Replication")
+		void GetReplicatedCandidates(TArray<AActor*>& OutCandidates) const;
+
+	/*
+	Ask the server to observe the actor. The request is validated by the world registry together with the other requests of the frame.
+	The actor must be in the array of observed actors of the server and in the radius of the collision.
+	Unreliable, a lost request is sent again by the next input. Needs bIsAcceptSwitchRequests or bIsReplicateSelection, so the component is replicated.
+	*/
+	UFUNCTION(Server, Unreliable, WithValidation, BlueprintCallable, Category = "TargetSelectionComponent|Replication")
+		void ServerRequestObservedActor(AActor* RequestedActor);
+
+	/*Ask the server to observe the actor by its index in the array of observed actors of the server. Unreliable, as ServerRequestObservedActor.*/
+	UFUNCTION(Server, Unreliable, WithValidation, BlueprintCallable, Category = "TargetSelectionComponent|Replication")
+		void ServerRequestObservedIndex(int32 RequestedIndex);
+
+	/*
+	Check the request of the client to observe the actor. Called by the world registry.
+	@param RequestedActor The actor requested by the client.
+	@param RequestedActorLocation The location of the actor read in this frame.
+	*/
+	bool IsSwitchRequestValid(AActor* RequestedActor, const FVector& RequestedActorLocation) const;
+
+	/*Turn the auto-targeting on or off. The component is registered in the world registry or removed from it.*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent|AutoTargeting")
+		void SetIsAutoTargeting(bool bIsEnabled);
+
+	/*Turn the line of sight check on or off. The tick of the component is turned on or off with it.*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent|LineOfSight")
+		void SetIsCheckLineOfSight(bool bIsEnabled);
+
+	/*
+	Get the significance of the owner for the auto-targeting from 0 to 1. The nearer and visible to the local player, the more often it is updated.
+	Override it to take the significance from the project, for example from the Significance Manager.
+	*/
+	UFUNCTION(BlueprintNativeEvent, BlueprintCallable, Category = "TargetSelectionComponent|AutoTargeting")
+		float GetAutoTargetingSignificance() const;
+
+	/*Is it the time of the next auto-targeting update?*/
+	bool IsAutoTargetingDue(float CurrentTime) const { return CurrentTime >= NextAutoTargetingTime; };
+
+	/*Take the actors again and switch to the nearest one. Called by the world registry no more than for the limited number of components per frame.*/
+	void UpdateAutoTargeting(float CurrentTime);
+
+	/*Called on the clients when the replicated selection came. Called once for the state and the candidates that came together.*/
+	UFUNCTION()
+		void OnRep_ReplicatedSelection();
+
+	/*Get an array of actors that can be observed without copying it.*/
+	const TArray<AActor*>& GetObservedActors() const { return SelectionCore.GetHandles(); };
 
 	/*Get collision for actor observation.*/
 	UFUNCTION(BlueprintGetter, Category = "TargetSelectionComponent")
 		USphereComponent* GetTargetSelectionCollision() { return TargetSelectionCollision; };
 
+	/*Get the radius in which the actors are taken: the radius of the collision or OverlapQueryRadius without the collision.*/
+	UFUNCTION(BlueprintPure, Category = "TargetSelectionComponent")
+		float GetWatchingRadius() const;
+
 	/*Get the current state - is it being observed now?*/
 	UFUNCTION(BlueprintGetter, Category = "TargetSelectionComponent")
 		bool GetIsWatchingNow() const { return bIsWatchingNow; };
@@ -215,8 +660,24 @@ public:
 	UFUNCTION(BlueprintGetter, Category = "TargetSelectionComponent")
 		bool GetIsCustomArray() { return bIsCustomArray; };
 
+	/*Get the filter profile used now.*/
+	UFUNCTION(BlueprintGetter, Category = "TargetSelectionComponent")
+		UTargetSelectionFilterProfile* GetCurrentFilterProfile() const { return CurrentFilterProfile; };
+
+	/*Get the number of the sorts skipped because nothing moved farther than SortMovementThreshold.*/
+	UFUNCTION(BlueprintGetter, Category = "TargetSelectionComponent")
+		int32 GetNumSkippedSorts() const { return NumSkippedSorts; };
+
+	/*Get the number of the sorts performed.*/
+	UFUNCTION(BlueprintGetter, Category = "TargetSelectionComponent")
+		int32 GetNumPerformedSorts() const { return NumPerformedSorts; };
+
+	/*Reset the numbers of the skipped and performed sorts.*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent")
+		void ResetSortCounters();
+
 	/*
-	Assign the observed actor by the pointer. The actor must be in the ObservedActorsArr array.
+	Assign the observed actor by the pointer. The actor must be in the array of observed actors.
 	If it is not in the array, add it using the AddActor method first.
 	NewObservedActor is checked for validity and presence in the array.
 	*/
@@ -227,6 +688,21 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent")
 		void SetObservedActorByIndex(int32 IndexOfNewObservedActor);
 
+	/*
+	Register the actor in the world registry (UTargetSelectionSubsystem). Used if bIsUseSpatialGrid == true.
+	The registry is shared by all components, the actor must be registered once.
+	@param TargetableActor The actor that can be observed.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent")
+		void RegisterTargetableActor(AActor* TargetableActor);
+
+	/*
+	Remove the actor from the world registry (UTargetSelectionSubsystem).
+	@param TargetableActor The actor registered by the RegisterTargetableActor method.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionComponent")
+		void UnregisterTargetableActor(AActor* TargetableActor);
+
 
 
 private:
@@ -256,27 +732,170 @@ private:
 	/*Switch between existing actors.*/
 	bool SwitchCurrentActors();
 
+	/*Observe the actor at the index: call the interfaces and OnSwitchActor. The array is not sorted and the snapshot is not published.*/
+	void SwitchObservedActor(int32 IndexOfNewObservedActor);
+
 	/*Switching to the first actor after switching on the observation mode.*/
 	bool SwitchToNewActor();
 
+	/*
+	Check the outside array and the key and switch the actors if the observation is already on.
+	Returns true if the observation must begin with the outside array.
+	*/
+	bool PrepareCustomArrayWatching(const TArray<AActor*>& CustomArray, FKey InputKey);
+
+	/*Sort the outside array already taken into SelectionCore and switch to the first actor.*/
+	void StartCustomArrayWatching();
+
+	/*Take the actors, sort them and switch to the first one. Used when the observation begins with the empty array.*/
+	void StartWatching();
+
+	/*Filter and sort the candidates on this thread or on the task graph and switch to the first one.*/
+	void WatchCandidateActors();
+
+	/*Send the async overlap query around the owner. The observation begins in OnOverlapQueryDone().*/
+	void StartOverlapQuery();
+
+	/*Take the actors found by the query and begin the observation. The results of the forgotten queries are skipped.*/
+	void OnOverlapQueryDone(const FTraceHandle& TraceHandle, FOverlapDatum& OverlapDatum, uint32 QuerySequence);
+
+	/*
+	Remove the actors that are not candidates anymore and add the new candidates, without switching.
+	@param OutNumAddedActors The number of the added actors.
+	@param OutNumRemovedActors The number of the removed actors.
+	*/
+	void RefreshObservedActors(int32& OutNumAddedActors, int32& OutNumRemovedActors);
+
+	/*Refresh the actors if they are not outside, sort them and switch to the nearest one once. If all the actors left, wait for the new ones.*/
+	void SwitchToNearestActor();
+
+	/*Start the job that takes the actors on the task graph. The result is applied by TickComponent() on the next frames.*/
+	void StartAsyncWatching();
+
+	/*Take the result of the finished job into the array and switch to the first actor.*/
+	void ApplyAsyncWatching();
+
+	/*Forget the job and the overlap query that are still running.*/
+	void CancelAsyncWatching();
+
+	/*Enable the tick while there is a job to apply or the line of sight is checked.*/
+	void UpdateTickEnabled();
+
+	/*
+	Check the line of sight to the actor by the cache. If the visibility is unknown or old, the trace is requested and the actor passes.
+	Returns false only if the actor is known to be hidden.
+	*/
+	bool CheckLineOfSight(AActor* CurrentActor);
+
+	/*Request the async line of sight trace to the actor if the budget of the frame allows. Returns false if the budget is spent.*/
+	bool RequestLineOfSight(AActor* CurrentActor, FTargetSelectionVisibility& Visibility);
+
+	/*Trace the observed actors with old visibility and the hidden candidates again.*/
+	void UpdateLineOfSight();
+
+	/*Take the result of the line of sight trace. Removes the actors that became hidden and adds the candidates that came into sight.*/
+	void OnLineOfSightTraced(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum, TWeakObjectPtr<AActor> TracedActor);
+
+	/*Keep the actor that began to overlap TargetSelectionCollision and add it to the observed actors.*/
+	UFUNCTION()
+		void OnTargetSelectionBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+
+	/*Forget the actor that stopped overlapping TargetSelectionCollision and remove it from the observed actors.*/
+	UFUNCTION()
+		void OnTargetSelectionEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+
+	/*Is the actor in the collision, in the radius of the spatial grid query, among the actors of the last overlap query or in the outside array?*/
+	bool IsCandidateActor(AActor* CurrentActor) const;
+
+	/*Copy the current filters by class and interface.*/
+	void GetCurrentCompiledFilter(FTargetSelectionCompiledFilter& OutFilter);
+
 	/*Call the IsObserved() method of the TargetSelectionInterface interface.*/
 	void CallInterfaceIsObserved();
 
 	/*Call the IsNotObserved() method of the TargetSelectionInterface interface.*/
 	void CallInterfaceIsNotObserved();
 
-	/*Take actors in the array ObservedActorsArr in the collision TargetSelectionCollision, including all filters.*/
+	/*Find out once per class how the observer interfaces are called for the actor.*/
+	const FTargetSelectionObserverDispatch& GetObserverDispatch(AActor* CurrentActor);
+
+	/*Take actors in the array of observed actors in the collision TargetSelectionCollision, including all filters.*/
 	bool GetAvailableActors();
 
+	/*Take the actors in the collision TargetSelectionCollision, in the spatial grid or found by the overlap query, without filters.*/
+	void GetCandidateActors(TArray<AActor*>& OutActors);
+
 	/*Sort the actor by filters.*/
 	bool SortActorByFilters(AActor* CurrentActor);
 
-	/*Sorting the ObservedActorsArr array by the distance to the owner.*/
+	/*Check the class of the actor by the filters by class and interface. The result is cached for the class.*/
+	bool CheckClassByFilters(UClass* ActorClass);
+
+	/*Check the class of the actor by the current filters by class and interface without the cache.*/
+	bool CheckClassByFiltersUncached(UClass* ActorClass) const;
+
+	/*
+	Add the candidates that passed the filters to the array of observed actors. The candidates are split into chunks filtered on the worker threads,
+	then the chunks are merged in order, so the result is the same as with SortActorByFilters().
+	*/
+	void FilterActorsInParallel(const TArray<AActor*>& Candidates);
+
+	/*Version of SortActorByFilters() that is safe to call from the worker threads. Doesn't write the caches and doesn't log.*/
+	bool SortActorByFiltersConcurrent(AActor* CurrentActor, const FTargetSelectionCompiledFilter* ProfileFilter, FTargetSelectionParallelChunk& Chunk) const;
+
+	/*Sorting the array of observed actors by the distance to the owner. The core keeps the index on the observed actor.*/
 	void SortActorsByDistance();
 
+	/*Read the locations of the owner and the observed actors in one pass, if they were not read in this frame yet.*/
+	void CacheActorLocations() const;
+
+	/*Are the locations read in this frame? The core keeps them in step with the array.*/
+	bool IsActorLocationsCacheValid() const { return ActorLocationsCacheFrame == GFrameCounter; };
+
+	/*Insert the actor into the sorted array by binary search on the distances of the last sort.*/
+	void InsertActorByDistance(AActor* NewActor);
+
+	/*Add the actor to the end of the array. Its location is read if the others are already read in this frame.*/
+	void AddObservedActor(AActor* NewActor);
+
+	/*Forget the filters and the input key of the observation.*/
+	void ResetFilters();
+
+	/*Forget the observed actors and turn off the observation, the filters are kept.*/
+	void StopWatching();
+
+	/*All the actors left. With the auto-targeting the filters are kept and the observation begins again when the candidates appear, else it is turned off.*/
+	void StopWatchingAllLeft();
+
+	/*Publish the snapshot of the current selection. Called after every change of the observed actor or the array.*/
+	void NotifySelectionChanged();
+
+	/*Write the current selection into the replicated properties on the server. Only the changed properties and items are marked.*/
+	void UpdateReplicatedSelection();
+
+	/*Get the registry of the actors of the world.*/
+	UTargetSelectionSubsystem* GetTargetSelectionSubsystem() const;
+
 protected:
+	// Called after the properties and the collision are initialized
+	virtual void PostInitProperties() override;
+
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
+	// Called when the game ends
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	// Replicated properties
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	// Reports the observed actors kept by SelectionCore to the garbage collector
+	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
+
+public:
+	// Called every frame while there is a job to apply or the line of sight is checked
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
 
 };
\ No newline at end of file
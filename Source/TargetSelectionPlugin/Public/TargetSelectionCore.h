@@ -0,0 +1,798 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+The candidates, ordering, cycling and removal rules of UTargetSelectionComponent without the engine types.
+The free functions take the elements by their indices and the squared distance keys. TTargetSelectionCore keeps the candidates
+of any handle and position types with the observed one and applies the rules to them.
+Header only, depends on the standard library only.
+*/
+namespace TargetSelectionCore
+{
+	/*The index of nothing, the same as INDEX_NONE of the engine.*/
+	const int32_t NoIndex = -1;
+
+	/*The array is sorted by insertion if at most 1 of this number of the elements moved since the last sort.*/
+	const int32_t CoherentSortMovedRatio = 8;
+
+	/*Does the element A go before the element B? The nearer goes first, equal keys keep the order of the array.*/
+	inline bool IsNearer(const float* Keys, int32_t A, int32_t B)
+	{
+		return Keys[A] < Keys[B] || (Keys[A] == Keys[B] && A < B);
+	}
+
+	/*Put the indices of all elements into OutIndices in the sorted order.*/
+	inline void SortIndicesByKeys(const float* Keys, int32_t Num, int32_t* OutIndices)
+	{
+		for (int32_t Index = 0; Index != Num; Index++)
+		{
+			OutIndices[Index] = Index;
+		}
+		std::sort(OutIndices, OutIndices + Num, [Keys](int32_t A, int32_t B)
+		{
+			return IsNearer(Keys, A, B);
+		});
+	}
+
+	/*
+	Version of SortIndicesByKeys() for the almost sorted elements, by insertion. The result is the same.
+	Returns the first position whose index is not its own, Num if the elements are already in order.
+	*/
+	inline int32_t InsertionSortIndicesByKeys(const float* Keys, int32_t Num, int32_t* OutIndices)
+	{
+		int32_t FirstMovedIndex = Num;
+		for (int32_t Index = 0; Index != Num; Index++)
+		{
+			/*The indices before Index are sorted. Equal keys stop the shift, so they keep the order of the array.*/
+			int32_t NewIndex = Index;
+			while (NewIndex > 0 && Keys[OutIndices[NewIndex - 1]] > Keys[Index])
+			{
+				OutIndices[NewIndex] = OutIndices[NewIndex - 1];
+				--NewIndex;
+			}
+			OutIndices[NewIndex] = Index;
+
+			if (NewIndex != Index)
+			{
+				FirstMovedIndex = std::min(FirstMovedIndex, NewIndex);
+			}
+		}
+		return FirstMovedIndex;
+	}
+
+	/*
+	Put the indices of the NumToOrder nearest elements into OutIndices in the sorted order, then the indices of the rest in the order of the array.
+	@param SelectedFlags Buffer of Num flags.
+	*/
+	template <typename FlagType>
+	inline void SelectNearestIndices(const float* Keys, int32_t Num, int32_t NumToOrder, int32_t* OutIndices, FlagType* SelectedFlags)
+	{
+		auto IsNearerIndex = [Keys](int32_t A, int32_t B)
+		{
+			return IsNearer(Keys, A, B);
+		};
+
+		/*Keep the NumToOrder nearest indices in a heap with the farthest of them on top.*/
+		int32_t NumSelected = 0;
+		for (int32_t Index = 0; Index != Num; Index++)
+		{
+			if (NumSelected < NumToOrder)
+			{
+				OutIndices[NumSelected++] = Index;
+				std::push_heap(OutIndices, OutIndices + NumSelected, IsNearerIndex);
+			}
+			else if (NumSelected > 0 && IsNearerIndex(Index, OutIndices[0]))
+			{
+				std::pop_heap(OutIndices, OutIndices + NumSelected, IsNearerIndex);
+				OutIndices[NumSelected - 1] = Index;
+				std::push_heap(OutIndices, OutIndices + NumSelected, IsNearerIndex);
+			}
+		}
+		std::sort(OutIndices, OutIndices + NumSelected, IsNearerIndex);
+
+		/*The rest keep the order of the array.*/
+		std::fill(SelectedFlags, SelectedFlags + Num, false);
+		for (int32_t Position = 0; Position != NumSelected; Position++)
+		{
+			SelectedFlags[OutIndices[Position]] = true;
+		}
+		for (int32_t Index = 0; Index != Num; Index++)
+		{
+			if (!SelectedFlags[Index])
+			{
+				OutIndices[NumSelected++] = Index;
+			}
+		}
+	}
+
+	/*Get the position of the new key among the sorted keys, after the equal ones.*/
+	inline int32_t FindInsertIndex(const float* SortedKeys, int32_t Num, float Key)
+	{
+		return int32_t(std::upper_bound(SortedKeys, SortedKeys + Num, Key) - SortedKeys);
+	}
+
+	/*Get the index observed after switching from CurrentIndex. The switching cycles through the first NumToCycle elements.*/
+	inline int32_t GetNextCycleIndex(int32_t CurrentIndex, int32_t NumToCycle)
+	{
+		return CurrentIndex < NumToCycle - 1 ? CurrentIndex + 1 : 0;
+	}
+
+	/*
+	Get the index observed after the observed element was removed.
+	@param ObservedIndex Index of the removed observed element before the removal.
+	@param NumRemovedBefore Number of the elements removed before it at the same time.
+	@param NumLeft Number of the elements left.
+	@param bIsSwitchToFirst Switch to the first element instead of the one that followed the removed element.
+	*/
+	inline int32_t GetIndexAfterRemoval(int32_t ObservedIndex, int32_t NumRemovedBefore, int32_t NumLeft, bool bIsSwitchToFirst)
+	{
+		if (bIsSwitchToFirst)
+		{
+			return 0;
+		}
+		const int32_t NewIndex = ObservedIndex - NumRemovedBefore;
+		return NewIndex > NumLeft - 1 ? 0 : NewIndex;
+	}
+
+	/*Get the number of the elements from the beginning of the array the switching cycles through. 0 NumNearestToOrder cycles through all.*/
+	inline int32_t GetNumToCycle(int32_t NumNearestToOrder, int32_t Num)
+	{
+		return NumNearestToOrder > 0 ? std::min(NumNearestToOrder, Num) : Num;
+	}
+
+	/*std::vector with the methods of TArray that TTargetSelectionCore uses.*/
+	template <typename ElementType>
+	class TStdArray
+	{
+	public:
+
+		int32_t Num() const { return int32_t(Elements.size()); }
+
+		ElementType* GetData() { return Elements.data(); }
+		const ElementType* GetData() const { return Elements.data(); }
+
+		ElementType& operator[](int32_t Index) { return Elements[Index]; }
+		const ElementType& operator[](int32_t Index) const { return Elements[Index]; }
+
+		int32_t Add(const ElementType& Element)
+		{
+			Elements.push_back(Element);
+			return Num() - 1;
+		}
+
+		void Append(const ElementType* Source, int32_t Count) { Elements.insert(Elements.end(), Source, Source + Count); }
+
+		void Insert(const ElementType& Element, int32_t Index) { Elements.insert(Elements.begin() + Index, Element); }
+
+		void RemoveAt(int32_t Index, int32_t Count, bool bAllowShrinking)
+		{
+			Elements.erase(Elements.begin() + Index, Elements.begin() + Index + Count);
+			if (bAllowShrinking)
+			{
+				Elements.shrink_to_fit();
+			}
+		}
+
+		void SetNum(int32_t NewNum, bool bAllowShrinking)
+		{
+			Elements.resize(NewNum);
+			if (bAllowShrinking)
+			{
+				Elements.shrink_to_fit();
+			}
+		}
+
+		/*Remove all elements, the memory is kept.*/
+		void Reset() { Elements.clear(); }
+
+		typename std::vector<ElementType>::iterator begin() { return Elements.begin(); }
+		typename std::vector<ElementType>::iterator end() { return Elements.end(); }
+		typename std::vector<ElementType>::const_iterator begin() const { return Elements.begin(); }
+		typename std::vector<ElementType>::const_iterator end() const { return Elements.end(); }
+
+	private:
+
+		std::vector<ElementType> Elements;
+	};
+
+	/*std::unordered_map with the methods of TMap that TTargetSelectionCore uses.*/
+	template <typename KeyType, typename ValueType>
+	class TStdMap
+	{
+	public:
+
+		int32_t Num() const { return int32_t(Pairs.size()); }
+
+		ValueType* Find(const KeyType& Key)
+		{
+			const auto Found = Pairs.find(Key);
+			return Found != Pairs.end() ? &Found->second : nullptr;
+		}
+
+		const ValueType* Find(const KeyType& Key) const
+		{
+			const auto Found = Pairs.find(Key);
+			return Found != Pairs.end() ? &Found->second : nullptr;
+		}
+
+		bool Contains(const KeyType& Key) const { return Pairs.count(Key) != 0; }
+
+		ValueType& Add(const KeyType& Key, const ValueType& Value) { return Pairs[Key] = Value; }
+
+		int32_t Remove(const KeyType& Key) { return int32_t(Pairs.erase(Key)); }
+
+		void Reset() { Pairs.clear(); }
+
+	private:
+
+		std::unordered_map<KeyType, ValueType> Pairs;
+	};
+
+	/*The containers of TTargetSelectionCore in the standalone build. The plugin gives TArray and TMap instead.*/
+	struct FStdContainers
+	{
+		template <typename ElementType>
+		using TArrayType = TStdArray<ElementType>;
+
+		template <typename KeyType, typename ValueType>
+		using TMapType = TStdMap<KeyType, ValueType>;
+	};
+}
+
+/*
+The candidates of the selection in the order of switching, the observed one and the rules that change them.
+	HandleType Identifies a candidate, compared by ==. HandleType() is no candidate.
+	PositionType The location of a candidate. Only copied by the core, the distances are computed by the caller.
+	ContainersType Gives TArrayType<Element> and TMapType<Key, Value> with the methods of TArray and TMap, see TargetSelectionCore::FStdContainers.
+The index of the observed candidate always points at it, whatever changes the array. The same handle may be added several times,
+then the first copy is found. The keys and positions of the last sort are kept by the indices, so a new candidate can be inserted
+at its place and a sort can be skipped if nothing moved.
+*/
+template <typename HandleType, typename PositionType, typename ContainersType = TargetSelectionCore::FStdContainers>
+class TTargetSelectionCore
+{
+public:
+
+	using FHandleArray = typename ContainersType::template TArrayType<HandleType>;
+	using FPositionArray = typename ContainersType::template TArrayType<PositionType>;
+
+	/*What removing the candidate does to the observation.*/
+	enum class ERemoval : uint8_t
+	{
+		/*The handle is not a candidate.*/
+		NotFound,
+		/*Another candidate is removed, the observed one stays.*/
+		Other,
+		/*The observed candidate is removed, the observation switches to another one.*/
+		Observed,
+		/*The observed candidate is the last one, nothing is left to observe.*/
+		Last
+	};
+
+	/*What the sort did.*/
+	enum class ESortResult : uint8_t
+	{
+		/*Nothing moved farther than the threshold, the order is kept.*/
+		Skipped,
+		/*Less than 2 candidates, only the keys and the positions are remembered.*/
+		Cached,
+		/*The candidates are reordered.*/
+		Sorted
+	};
+
+	TTargetSelectionCore()
+		: ObservedHandle()
+		, ObservedIndex(TargetSelectionCore::NoIndex)
+		, RemovedObservedIndex(0)
+		, bIsOrderValid(false)
+		, NumOrdered(0)
+		, SortOwnerPosition()
+		, FirstStaleIndex(0)
+	{
+	}
+
+	/*Number of the candidates.*/
+	int32_t Num() const { return Handles.Num(); }
+
+	bool IsValidIndex(int32_t Index) const { return Index >= 0 && Index < Handles.Num(); }
+
+	/*The candidates in the order of switching.*/
+	const FHandleArray& GetHandles() const { return Handles; }
+
+	const HandleType& GetHandle(int32_t Index) const { return Handles[Index]; }
+
+	/*The position of the candidate given by Add() or UpdatePositions().*/
+	const PositionType& GetPosition(int32_t Index) const { return Positions[Index]; }
+
+	/*The observed candidate, HandleType() if there is none.*/
+	const HandleType& GetObserved() const { return ObservedHandle; }
+
+	/*Index of the observed candidate, NoIndex if there is none.*/
+	int32_t GetObservedIndex() const { return ObservedIndex; }
+
+	bool HasObserved() const { return ObservedIndex != TargetSelectionCore::NoIndex; }
+
+	/*Do the keys and the positions of the last sort match the candidates? Then the first GetNumOrdered() are sorted and the rest are not nearer.*/
+	bool IsOrderValid() const { return bIsOrderValid; }
+
+	int32_t GetNumOrdered() const { return NumOrdered; }
+
+	/*Find the index of the first copy of the handle. Returns NoIndex if it is not a candidate.*/
+	int32_t Find(const HandleType& Handle) const
+	{
+		UpdateIndices();
+		const int32_t* FoundIndex = Indices.Find(Handle);
+		return FoundIndex != nullptr ? *FoundIndex : TargetSelectionCore::NoIndex;
+	}
+
+	bool Contains(const HandleType& Handle) const { return Find(Handle) != TargetSelectionCore::NoIndex; }
+
+	/*Rebuild the stale indices. Called by the lookups. Nothing is written if nothing is stale, so call it before the other threads look up.*/
+	void UpdateIndices() const
+	{
+		if (FirstStaleIndex >= Handles.Num())
+		{
+			return;
+		}
+
+		/*The indices before the stale range are right. Every handle whose first copy is in the stale range has no index or a stale one.
+		Going backwards, the first copy is written last.*/
+		for (int32_t Index = Handles.Num() - 1; Index >= FirstStaleIndex; Index--)
+		{
+			const int32_t* StoredIndex = Indices.Find(Handles[Index]);
+			if (StoredIndex == nullptr || *StoredIndex >= FirstStaleIndex)
+			{
+				Indices.Add(Handles[Index], Index);
+			}
+		}
+		FirstStaleIndex = Handles.Num();
+	}
+
+	/*Number of the different handles.*/
+	int32_t GetNumUnique() const
+	{
+		UpdateIndices();
+		return Indices.Num();
+	}
+
+	/*Call Function(Handle&) for every stored handle, so the caller can report or clear the references.*/
+	template <typename FunctionType>
+	void ForEachHandleReference(FunctionType Function)
+	{
+		bool bIsChanged = false;
+		for (int32_t Index = 0; Index != Handles.Num(); Index++)
+		{
+			const HandleType PreviousHandle = Handles[Index];
+			Function(Handles[Index]);
+			bIsChanged = bIsChanged || !(Handles[Index] == PreviousHandle);
+		}
+		Function(ObservedHandle);
+
+		/*The changed handles are indexed again on the next lookup.*/
+		if (bIsChanged)
+		{
+			Indices.Reset();
+			FirstStaleIndex = 0;
+		}
+	}
+
+	/*Set the positions of all candidates to GetPosition(Handle). The positions are a cache of the caller, so it is const.*/
+	template <typename FunctionType>
+	void UpdatePositions(FunctionType GetPosition) const
+	{
+		for (int32_t Index = 0; Index != Handles.Num(); Index++)
+		{
+			Positions[Index] = GetPosition(Handles[Index]);
+		}
+	}
+
+	/*Remove all candidates and the observed one. The memory is kept.*/
+	void Reset()
+	{
+		Handles.Reset();
+		Positions.Reset();
+		Keys.Reset();
+		SortPositions.Reset();
+		Indices.Reset();
+		FirstStaleIndex = 0;
+		bIsOrderValid = false;
+		NumOrdered = 0;
+		ClearObserved();
+	}
+
+	/*Take the array as the candidates, copied or moved. Nothing is observed, the positions must be set by UpdatePositions().*/
+	template <typename ArrayType>
+	void Assign(ArrayType&& NewHandles)
+	{
+		Reset();
+		Handles = std::forward<ArrayType>(NewHandles);
+		Positions.SetNum(Handles.Num(), false);
+	}
+
+	/*Add the candidate to the end. The order of the last sort is lost. Returns its index.*/
+	int32_t Add(const HandleType& Handle, const PositionType& Position)
+	{
+		const int32_t NewIndex = Handles.Add(Handle);
+		Positions.Add(Position);
+
+		/*The earlier copy of the handle keeps its index.*/
+		if (Indices.Find(Handle) == nullptr)
+		{
+			Indices.Add(Handle, NewIndex);
+		}
+		if (FirstStaleIndex == NewIndex)
+		{
+			FirstStaleIndex = Handles.Num();
+		}
+		bIsOrderValid = false;
+		return NewIndex;
+	}
+
+	/*
+	Insert the candidate among the ordered ones after the ones with the same key. If it is farther than all of them, it goes to the end.
+	The order must be valid. Returns its index.
+	@param Key Squared distance from the position of the owner at the last sort.
+	*/
+	int32_t InsertByKey(const HandleType& Handle, const PositionType& Position, float Key)
+	{
+		int32_t NewIndex = TargetSelectionCore::FindInsertIndex(Keys.GetData(), NumOrdered, Key);
+		if (NewIndex < NumOrdered || NumOrdered == Handles.Num())
+		{
+			++NumOrdered;
+		}
+		else
+		{
+			NewIndex = Handles.Num();
+		}
+		Handles.Insert(Handle, NewIndex);
+		Positions.Insert(Position, NewIndex);
+		Keys.Insert(Key, NewIndex);
+		SortPositions.Insert(Position, NewIndex);
+		MarkIndicesStale(NewIndex);
+
+		if (HasObserved() && NewIndex <= ObservedIndex)
+		{
+			++ObservedIndex;
+		}
+		return NewIndex;
+	}
+
+	/*Find out what removing the handle does to the observation, without removing it.*/
+	ERemoval GetRemoval(const HandleType& Handle) const
+	{
+		if (!Contains(Handle))
+		{
+			return ERemoval::NotFound;
+		}
+		if (HasObserved() && Handle == ObservedHandle)
+		{
+			return Handles.Num() == 1 ? ERemoval::Last : ERemoval::Observed;
+		}
+		return ERemoval::Other;
+	}
+
+	/*
+	Remove the candidate by the index. If it is the observed one, nothing is observed until ObserveAfterRemoval(),
+	else the index of the observed one follows it.
+	*/
+	void RemoveAt(int32_t Index)
+	{
+		const HandleType RemovingHandle = Handles[Index];
+
+		/*The arrays keep their memory, the next added candidate takes it.*/
+		Handles.RemoveAt(Index, 1, false);
+		Positions.RemoveAt(Index, 1, false);
+
+		/*Forget the index if it is of the removed copy or stale. The later copies of the handle are found again by the rebuild.*/
+		const int32_t* FoundIndex = Indices.Find(RemovingHandle);
+		if (FoundIndex != nullptr && (*FoundIndex == Index || *FoundIndex >= FirstStaleIndex))
+		{
+			Indices.Remove(RemovingHandle);
+		}
+
+		/*The candidates after the removed one are shifted, their indices are rebuilt on the next lookup.*/
+		MarkIndicesStale(Index);
+
+		if (bIsOrderValid)
+		{
+			Keys.RemoveAt(Index, 1, false);
+			SortPositions.RemoveAt(Index, 1, false);
+			if (Index < NumOrdered)
+			{
+				--NumOrdered;
+			}
+		}
+
+		if (Index == ObservedIndex)
+		{
+			ClearObserved();
+			RemovedObservedIndex = Index;
+		}
+		else if (HasObserved() && Index < ObservedIndex)
+		{
+			--ObservedIndex;
+		}
+	}
+
+	/*
+	Remove the candidates for which ShouldRemove(Handle) is true in one pass. The observed one is handled as by RemoveAt().
+	Returns the number of the removed candidates.
+	*/
+	template <typename PredicateType>
+	int32_t RemoveAll(PredicateType ShouldRemove)
+	{
+		int32_t NumRemovedBeforeObserved = 0;
+		int32_t NumRemovedOrdered = 0;
+		bool bIsObservedRemoved = false;
+		int32_t WriteIndex = 0;
+		for (int32_t ReadIndex = 0; ReadIndex != Handles.Num(); ReadIndex++)
+		{
+			if (ShouldRemove(Handles[ReadIndex]))
+			{
+				if (ReadIndex < ObservedIndex)
+				{
+					++NumRemovedBeforeObserved;
+				}
+				else if (ReadIndex == ObservedIndex)
+				{
+					bIsObservedRemoved = true;
+				}
+				if (ReadIndex < NumOrdered)
+				{
+					++NumRemovedOrdered;
+				}
+				continue;
+			}
+			Handles[WriteIndex] = Handles[ReadIndex];
+			Positions[WriteIndex] = Positions[ReadIndex];
+			if (bIsOrderValid)
+			{
+				Keys[WriteIndex] = Keys[ReadIndex];
+				SortPositions[WriteIndex] = SortPositions[ReadIndex];
+			}
+			++WriteIndex;
+		}
+		const int32_t NumRemoved = Handles.Num() - WriteIndex;
+
+		Handles.SetNum(WriteIndex, false);
+		Positions.SetNum(WriteIndex, false);
+		if (bIsOrderValid)
+		{
+			Keys.SetNum(WriteIndex, false);
+			SortPositions.SetNum(WriteIndex, false);
+			NumOrdered -= NumRemovedOrdered;
+		}
+		Indices.Reset();
+		FirstStaleIndex = 0;
+
+		/*The index of the observed candidate moves back by the number of the candidates removed before it.*/
+		if (bIsObservedRemoved)
+		{
+			RemovedObservedIndex = ObservedIndex - NumRemovedBeforeObserved;
+			ClearObserved();
+		}
+		else if (HasObserved())
+		{
+			ObservedIndex -= NumRemovedBeforeObserved;
+		}
+		return NumRemoved;
+	}
+
+	/*
+	Observe a candidate after the observed one was removed: the first one, or the one that followed the removed one.
+	There must be a candidate and nothing observed.
+	*/
+	void ObserveAfterRemoval(bool bIsSwitchToFirst)
+	{
+		SetObservedIndex(TargetSelectionCore::GetIndexAfterRemoval(RemovedObservedIndex, 0, Handles.Num(), bIsSwitchToFirst));
+	}
+
+	/*Observe the candidate at the index.*/
+	void SetObservedIndex(int32_t Index)
+	{
+		ObservedIndex = Index;
+		ObservedHandle = Handles[Index];
+	}
+
+	/*Get the index the next switch observes: the next candidate, or the first one after the last. Only the first NumNearestToOrder are cycled through if it is not 0.*/
+	int32_t GetNextObservedIndex(int32_t NumNearestToOrder) const
+	{
+		return TargetSelectionCore::GetNextCycleIndex(ObservedIndex, TargetSelectionCore::GetNumToCycle(NumNearestToOrder, Handles.Num()));
+	}
+
+	/*Observe nothing.*/
+	void ClearObserved()
+	{
+		ObservedIndex = TargetSelectionCore::NoIndex;
+		ObservedHandle = HandleType();
+	}
+
+	/*
+	Observe the next candidate, or the first one after the last. There must be a candidate.
+	@param NumNearestToOrder Only the first ones are cycled through if it is not 0.
+	*/
+	int32_t CycleObserved(int32_t NumNearestToOrder)
+	{
+		SetObservedIndex(GetNextObservedIndex(NumNearestToOrder));
+		return ObservedIndex;
+	}
+
+	/*
+	Order the candidates by the keys, nearest first. The observed candidate keeps being observed at its new index.
+	@param NewKeys Squared distances from OwnerPosition to the current positions, by the indices of the candidates.
+	@param OwnerPosition The position the keys are computed from.
+	@param NumNearestToOrder Only so many nearest candidates are ordered, the rest stay unordered. 0 orders all.
+	@param MovementThreshold If it is not 0 and nothing moved farther since the last sort, the sort is skipped.
+		If a few candidates moved, they are moved to their places by insertion.
+	@param DistanceSquared Function (const PositionType&, const PositionType&) returning the squared distance.
+	*/
+	template <typename DistanceSquaredType>
+	ESortResult Sort(const float* NewKeys, const PositionType& OwnerPosition, int32_t NumNearestToOrder, float MovementThreshold, DistanceSquaredType DistanceSquared)
+	{
+		const int32_t NumHandles = Handles.Num();
+
+		/*Nothing to sort, only remember the keys.*/
+		if (NumHandles < 2)
+		{
+			Keys.Reset();
+			SortPositions.Reset();
+			for (int32_t Index = 0; Index != NumHandles; Index++)
+			{
+				Keys.Add(NewKeys[Index]);
+				SortPositions.Add(Positions[Index]);
+			}
+			bIsOrderValid = true;
+			NumOrdered = NumHandles;
+			SortOwnerPosition = OwnerPosition;
+			return ESortResult::Cached;
+		}
+
+		const int32_t NumToOrder = TargetSelectionCore::GetNumToCycle(NumNearestToOrder, NumHandles);
+
+		/*If the candidates didn't change since the last sort, compare the positions with the ones of the last sort.*/
+		bool bIsAlmostSorted = false;
+		if (MovementThreshold > 0.f && bIsOrderValid && NumOrdered == NumToOrder)
+		{
+			const int32_t NumMoved = CountMovedSinceSort(OwnerPosition, MovementThreshold * MovementThreshold, DistanceSquared);
+
+			/*Nothing moved farther than the threshold, the order is kept. The positions of the last sort are kept too, so slow movement is not missed.*/
+			if (NumMoved == 0)
+			{
+				return ESortResult::Skipped;
+			}
+
+			/*A few candidates moved, the array is almost sorted.*/
+			bIsAlmostSorted = NumMoved != TargetSelectionCore::NoIndex && NumToOrder == NumHandles
+				&& NumMoved * TargetSelectionCore::CoherentSortMovedRatio <= NumHandles;
+		}
+
+		/*Order the indices by the keys. Equal keys keep the order of the array.*/
+		SortIndices.SetNum(NumHandles, false);
+		int32_t FirstMovedIndex = 0;
+		if (bIsAlmostSorted)
+		{
+			FirstMovedIndex = TargetSelectionCore::InsertionSortIndicesByKeys(NewKeys, NumHandles, SortIndices.GetData());
+		}
+		/*If only the nearest candidates are ordered, select them without sorting the rest.*/
+		else if (NumToOrder < NumHandles)
+		{
+			SortSelectedFlags.SetNum(NumHandles, false);
+			TargetSelectionCore::SelectNearestIndices(NewKeys, NumHandles, NumToOrder, SortIndices.GetData(), SortSelectedFlags.GetData());
+		}
+		else
+		{
+			TargetSelectionCore::SortIndicesByKeys(NewKeys, NumHandles, SortIndices.GetData());
+		}
+
+		/*Reorder the candidates by the sorted indices. The index of the observed one follows it.*/
+		HandlesBuffer.Reset();
+		HandlesBuffer.Append(Handles.GetData(), NumHandles);
+		PositionsBuffer.Reset();
+		PositionsBuffer.Append(Positions.GetData(), NumHandles);
+		Keys.SetNum(NumHandles, false);
+		SortPositions.SetNum(NumHandles, false);
+		const int32_t ObservedIndexBeforeSort = ObservedIndex;
+		for (int32_t Index = 0; Index != NumHandles; Index++)
+		{
+			const int32_t SortedIndex = SortIndices[Index];
+			Handles[Index] = HandlesBuffer[SortedIndex];
+			Positions[Index] = PositionsBuffer[SortedIndex];
+			Keys[Index] = NewKeys[SortedIndex];
+			SortPositions[Index] = Positions[Index];
+			if (SortedIndex == ObservedIndexBeforeSort)
+			{
+				ObservedIndex = Index;
+			}
+		}
+		bIsOrderValid = true;
+		NumOrdered = NumToOrder;
+		SortOwnerPosition = OwnerPosition;
+
+		/*Only the candidates that changed the places are reindexed.*/
+		if (FirstMovedIndex != NumHandles)
+		{
+			MarkIndicesStale(FirstMovedIndex);
+		}
+		return ESortResult::Sorted;
+	}
+
+private:
+
+	/*
+	Count the candidates that moved farther than the threshold since the last sort.
+	Returns NoIndex if the owner moved farther.
+	*/
+	template <typename DistanceSquaredType>
+	int32_t CountMovedSinceSort(const PositionType& OwnerPosition, float ThresholdSquared, DistanceSquaredType& DistanceSquared) const
+	{
+		if (DistanceSquared(OwnerPosition, SortOwnerPosition) > ThresholdSquared)
+		{
+			return TargetSelectionCore::NoIndex;
+		}
+
+		int32_t NumMoved = 0;
+		for (int32_t Index = 0; Index != SortPositions.Num(); Index++)
+		{
+			if (DistanceSquared(Positions[Index], SortPositions[Index]) > ThresholdSquared)
+			{
+				++NumMoved;
+			}
+		}
+		return NumMoved;
+	}
+
+	/*Mark the indices of the candidates starting from FirstIndex stale. They are rebuilt by UpdateIndices() on the next lookup.*/
+	void MarkIndicesStale(int32_t FirstIndex)
+	{
+		FirstStaleIndex = std::min(FirstStaleIndex, FirstIndex);
+	}
+
+	/*The candidates in the order of switching.*/
+	FHandleArray Handles;
+
+	/*Positions of the candidates, by the same indices. A cache of the caller, refreshed by UpdatePositions().*/
+	mutable FPositionArray Positions;
+
+	/*The observed candidate.*/
+	HandleType ObservedHandle;
+
+	/*Index of ObservedHandle in Handles, NoIndex if nothing is observed.*/
+	int32_t ObservedIndex;
+
+	/*Index of the removed observed candidate after the removal. Used by ObserveAfterRemoval().*/
+	int32_t RemovedObservedIndex;
+
+	/*Squared distances of the last sort, by the indices. Used if bIsOrderValid == true.*/
+	typename ContainersType::template TArrayType<float> Keys;
+
+	/*Positions of the candidates at the last sort, by the indices. Used if bIsOrderValid == true.*/
+	FPositionArray SortPositions;
+
+	/*Do Keys and SortPositions match the candidates?*/
+	bool bIsOrderValid;
+
+	/*Number of the sorted candidates at the beginning. Used if bIsOrderValid == true.*/
+	int32_t NumOrdered;
+
+	/*Position of the owner at the last sort.*/
+	PositionType SortOwnerPosition;
+
+	/*Indices of the handles. If a handle is stored several times, the first index is stored.*/
+	mutable typename ContainersType::template TMapType<HandleType, int32_t> Indices;
+
+	/*The first index whose entry in Indices may be stale. Equals the number of candidates if nothing is stale.*/
+	mutable int32_t FirstStaleIndex;
+
+	/*Buffers of Sort(). They keep their memory between the sorts.*/
+	typename ContainersType::template TArrayType<int32_t> SortIndices;
+	typename ContainersType::template TArrayType<uint8_t> SortSelectedFlags;
+	FHandleArray HandlesBuffer;
+	FPositionArray PositionsBuffer;
+};
@@ -0,0 +1,80 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "TargetSelectionFilterProfile.generated.h"
+
+/*
+The filters of the profile prepared for the checks.
+The classes are stored in sets, so a class is checked by one walk up its ancestry, whatever the number of the filters.
+*/
+struct TARGETSELECTIONPLUGIN_API FTargetSelectionCompiledFilter
+{
+	/*Classes to be observed. Empty means any class.*/
+	TSet<const UClass*> IncludeClasses;
+
+	/*Classes to be ignored.*/
+	TSet<const UClass*> ExcludeClasses;
+
+	/*The interface the observed actors must implement. nullptr means any.*/
+	UClass* InterfaceClass = nullptr;
+
+	/*Results of the checks for the classes already checked.*/
+	mutable TMap<const UClass*, bool> Verdicts;
+
+	/*Check the class by the filters. The result is cached for the class.*/
+	bool CheckClass(const UClass* ActorClass) const;
+
+	/*Check the class by the filters without the cache.*/
+	bool CheckClassUncached(const UClass* ActorClass) const;
+
+	/*Remove all filters.*/
+	void Reset();
+};
+
+/*
+Reusable set of the filters for UTargetSelectionComponent::WatchActors_FilterProfile().
+The filters are checked and compiled once at load, so switching between the profiles costs nothing.
+*/
+UCLASS(BlueprintType)
+class TARGETSELECTIONPLUGIN_API UTargetSelectionFilterProfile : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	/*An array of references to the actor classes to be observed. If it is empty, all classes are observed.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionFilterProfile")
+		TArray<TSubclassOf<AActor>> ClassesFilter;
+
+	/*An array of references to classes to be excluded from observation.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionFilterProfile")
+		TArray<TSubclassOf<AActor>> ClassesFilterException;
+
+	/*Reference to the class of the interface that inherits the actors to be observed. If it is not set, it is not checked.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "TargetSelectionFilterProfile")
+		TSubclassOf<UInterface> InterfaceFilter;
+
+	/*Get the compiled filters. They are compiled on the first call if they were not compiled at load.*/
+	const FTargetSelectionCompiledFilter& GetCompiledFilter();
+
+	/*Compile the filters again. Must be called after changing the filters at runtime.*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionFilterProfile")
+		void CompileFilter();
+
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+
+	/*The compiled filters.*/
+	FTargetSelectionCompiledFilter CompiledFilter;
+
+	/*Are the filters compiled?*/
+	bool bIsCompiled = false;
+};
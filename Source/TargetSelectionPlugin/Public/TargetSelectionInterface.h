@@ -32,3 +32,28 @@ public:
 		void IsNotObserved();
 
 };
+
+// This class does not need to be modified.
+UINTERFACE(Category = "TargetSelectionInterface", meta = (CannotImplementInterfaceInBlueprint))
+class UTargetSelectionNativeInterface : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * C++ version of TargetSelectionInterface. The component calls it directly, without reflection.
+ * If the actor implements both interfaces, only this one is called.
+ */
+class TARGETSELECTIONPLUGIN_API ITargetSelectionNativeInterface
+{
+	GENERATED_BODY()
+
+public:
+
+	/*Called from the actor when the actor begins to observe.*/
+	virtual void OnObserved() = 0;
+
+	/*Called from the actor when the actor finishes observing.*/
+	virtual void OnNotObserved() = 0;
+
+};
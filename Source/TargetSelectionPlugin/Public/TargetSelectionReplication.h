@@ -0,0 +1,87 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "TargetSelectionReplication.generated.h"
+
+class AActor;
+
+/*
+The observed actor of the server, with the index and the number of the candidates quantized.
+Its notification is the only one of the replicated selection, the candidates change it by CandidatesVersion.
+*/
+USTRUCT()
+struct FTargetSelectionReplicatedState
+{
+	GENERATED_BODY()
+
+	/*The actor being observed on the server.*/
+	UPROPERTY()
+		AActor* ObservedActor = nullptr;
+
+	/*Index of the observed actor in the array of the server, clamped to 65535.*/
+	UPROPERTY()
+		uint16 IndexOfObservedActor = 0;
+
+	/*Number of the valid places of the replicated candidates.*/
+	UPROPERTY()
+		uint8 NumCandidates = 0;
+
+	/*Increases when the replicated candidates change, so the state is sent and notified with them.*/
+	UPROPERTY()
+		uint8 CandidatesVersion = 0;
+};
+
+/*One candidate of the replicated selection.*/
+USTRUCT()
+struct FTargetSelectionReplicatedCandidate : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	/*The candidate.*/
+	UPROPERTY()
+		AActor* Actor = nullptr;
+
+	/*Place of the candidate in the ordered array. The fast array doesn't keep the order of the items on the clients.*/
+	UPROPERTY()
+		uint8 Order = 0;
+};
+
+/*
+The first candidates of the ordered array of the server. Only the changed items are sent.
+The items are kept by the places, so a switch without reordering sends nothing.
+The items are not notified one by one: the change of FTargetSelectionReplicatedState::CandidatesVersion comes with them.
+*/
+USTRUCT()
+struct FTargetSelectionReplicatedCandidates : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		TArray<FTargetSelectionReplicatedCandidate> Items;
+
+	/*
+	Put the actors into the items by their places. Called on the server.
+	Returns true if something changed.
+	*/
+	bool SetCandidates(const TArray<AActor*>& Actors, int32 NumCandidates);
+
+	/*Take the actors of the first NumCandidates places in the order of the server. The places that didn't come yet are nullptr.*/
+	void GetCandidates(TArray<AActor*>& OutActors, int32 NumCandidates) const;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FTargetSelectionReplicatedCandidate, FTargetSelectionReplicatedCandidates>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FTargetSelectionReplicatedCandidates> : public TStructOpsTypeTraitsBase2<FTargetSelectionReplicatedCandidates>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
@@ -0,0 +1,85 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+
+/*
+Immutable copy of the current selection of UTargetSelectionComponent.
+It has a fixed size and is copied as a whole, so it can be read on any thread.
+It holds only plain data: the actors are given by their keys and names. A key can be resolved to the actor
+by FObjectKey::ResolveObjectPtr() only on the game thread, where the actor can't be destroyed meanwhile.
+*/
+struct FTargetSelectionSnapshot
+{
+	/*The largest number of the candidates in the snapshot.*/
+	static const int32 MaxCandidates = 8;
+
+	/*Number of the snapshot. Increases with every change of the selection. 0 if nothing was published.*/
+	uint32 Sequence = 0;
+
+	/*Is the observation in process?*/
+	bool bIsWatching = false;
+
+	/*Key of the actor being observed. Empty if nothing is observed.*/
+	FObjectKey ObservedActorKey;
+
+	/*Name of the actor being observed. NAME_None if nothing is observed.*/
+	FName ObservedActorName;
+
+	/*Location of the actor being observed when the snapshot was taken.*/
+	FVector ObservedActorLocation = FVector::ZeroVector;
+
+	/*Index of the observed actor in the array of observed actors.*/
+	int32 IndexOfObservedActor = INDEX_NONE;
+
+	/*Number of all observed actors.*/
+	int32 NumObservedActors = 0;
+
+	/*Number of the valid elements of CandidateKeys and CandidateDistances.*/
+	int32 NumCandidates = 0;
+
+	/*Keys of the first actors of the array of observed actors. The nearest ones if the array is sorted.*/
+	FObjectKey CandidateKeys[MaxCandidates];
+
+	/*Distances from the owner to the candidates when the snapshot was taken.*/
+	float CandidateDistances[MaxCandidates];
+};
+
+/*
+Publishes the snapshots from the game thread to the readers on any thread without locks.
+There are two slots: the writer fills the slot not published last, so the readers of the published one don't wait.
+Every slot has a version that is odd while the slot is written. A reader copies the slot and retries
+only if the version changed meanwhile, that is only if the writer published twice during the copy.
+*/
+class TARGETSELECTIONPLUGIN_API FTargetSelectionSnapshotBuffer
+{
+public:
+
+	FTargetSelectionSnapshotBuffer();
+
+	/*Publish the new snapshot. Its Sequence is assigned here. Must be called by one thread only.*/
+	void Publish(const FTargetSelectionSnapshot& NewSnapshot);
+
+	/*Copy the last published snapshot. Can be called on any thread.*/
+	void Read(FTargetSelectionSnapshot& OutSnapshot) const;
+
+	/*Get the number of the last published snapshot. Can be called on any thread.*/
+	uint32 GetSequence() const;
+
+private:
+
+	struct FSlot
+	{
+		/*Odd while the snapshot is written.*/
+		volatile int32 Version;
+
+		FTargetSelectionSnapshot Snapshot;
+	};
+
+	FSlot Slots[2];
+
+	/*Number of the last published snapshot. It is in Slots[Sequence % 2].*/
+	volatile int32 Sequence;
+};
@@ -0,0 +1,82 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AActor;
+
+/*
+Uniform spatial hash grid of actors.
+Every actor is stored in the cell containing its location, so a radius query only visits the cells
+that overlap the bounding box of the query sphere.
+*/
+class TARGETSELECTIONPLUGIN_API FTargetSelectionSpatialGrid
+{
+public:
+
+	FTargetSelectionSpatialGrid();
+
+	/*Set the size of one cell. The actors already in the grid are rehashed.*/
+	void SetCellSize(float InCellSize);
+
+	/*Get the size of one cell.*/
+	float GetCellSize() const { return CellSize; };
+
+	/*Add the actor to the grid or update its location if it is already there.*/
+	void AddActor(AActor* Actor, const FVector& Location);
+
+	/*Remove the actor from the grid.*/
+	void RemoveActor(AActor* Actor);
+
+	/*Update the location of the actor. The actor changes the cell only if it crossed the cell border.*/
+	void UpdateActor(AActor* Actor, const FVector& Location);
+
+	/*
+	Take the actors whose stored location is inside the sphere.
+		@param Origin Center of the sphere.
+		@param Radius Radius of the sphere.
+		@param OutActors The found actors are appended to this array.
+	*/
+	void QueryRadius(const FVector& Origin, float Radius, TArray<AActor*>& OutActors) const;
+
+	/*Get the location the actor was stored with. Returns nullptr if the actor is not in the grid.*/
+	const FVector* FindLocation(const AActor* Actor) const
+	{
+		const FEntry* FoundEntry = Entries.Find(Actor);
+		return FoundEntry != nullptr ? &FoundEntry->Location : nullptr;
+	};
+
+	/*Is the actor in the grid?*/
+	bool Contains(const AActor* Actor) const { return Entries.Contains(Actor); };
+
+	/*Number of actors in the grid.*/
+	int32 Num() const { return Entries.Num(); };
+
+	/*Remove all actors.*/
+	void Empty();
+
+private:
+
+	/*Where the actor is stored.*/
+	struct FEntry
+	{
+		FIntVector Cell;
+		FVector Location;
+	};
+
+	/*Get the cell of the location.*/
+	FIntVector GetCell(const FVector& Location) const;
+
+	/*Remove the actor from the cell and the cell itself if it is empty.*/
+	void RemoveFromCell(AActor* Actor, const FIntVector& Cell);
+
+	/*Actors by cells.*/
+	TMap<FIntVector, TArray<AActor*>> Cells;
+
+	/*Cells and locations by actors.*/
+	TMap<const AActor*, FEntry> Entries;
+
+	float CellSize;
+	float InvCellSize;
+};
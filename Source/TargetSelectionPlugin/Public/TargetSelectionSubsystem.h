@@ -0,0 +1,189 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tickable.h"
+#include "TargetSelectionSpatialGrid.h"
+#include "TargetSelectionSubsystem.generated.h"
+
+class UTargetSelectionFilterProfile;
+class UTargetSelectionComponent;
+class UNetConnection;
+
+/*
+Registry of the actors that can be observed, shared by all UTargetSelectionComponent of the current world of the game instance.
+The actors register once, their locations are read once per frame into one spatial grid,
+and the components query the grid instead of scanning their own collisions.
+The registry is emptied when the world is cleaned up, for example on the travel to another map.
+*/
+UCLASS()
+class TARGETSELECTIONPLUGIN_API UTargetSelectionSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+
+	/*
+	Register the actor in the registry. The registry follows the movement of the actor and forgets the actor when it is destroyed.
+	@param TargetableActor The actor that can be observed.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionSubsystem")
+		void RegisterTargetableActor(AActor* TargetableActor);
+
+	/*
+	Remove the actor from the registry.
+	@param TargetableActor The actor registered by the RegisterTargetableActor method.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionSubsystem")
+		void UnregisterTargetableActor(AActor* TargetableActor);
+
+	/*
+	Take the registered actors within the sphere that pass the filters of the profile.
+	@param Origin Center of the sphere.
+	@param Radius Radius of the sphere.
+	@param FilterProfile The filters. If it is not set, all actors are taken.
+	@param OutActors The found actors are appended to this array.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionSubsystem")
+		void QueryTargetableActors(FVector Origin, float Radius, UTargetSelectionFilterProfile* FilterProfile, TArray<AActor*>& OutActors);
+
+	/*Set the size of one cell of the spatial grid. It is recommended to set it about the radius of the queries.*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionSubsystem")
+		void SetCellSize(float CellSize);
+
+	/*Get the number of the registered actors.*/
+	UFUNCTION(BlueprintPure, Category = "TargetSelectionSubsystem")
+		int32 GetNumTargetableActors() const { return RegisteredActors.Num(); };
+
+	/*
+	Queue the request of the client to observe the actor. The requests of the frame are checked in one pass on the next tick,
+	and only the last request of every component is applied. Called on the server.
+	@param Component The component of the client.
+	@param RequestedActor The actor requested by the client.
+	*/
+	void QueueSwitchRequest(UTargetSelectionComponent* Component, AActor* RequestedActor);
+
+	/*
+	Set how many requests to switch the actor one connection can send.
+	@param RequestsPerSecond Number of the requests per second on average.
+	@param MaxBurst Number of the requests that can be sent at once.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionSubsystem")
+		void SetSwitchRequestRateLimit(float RequestsPerSecond, int32 MaxBurst);
+
+	/*
+	Add the component to the auto-targeting updates. No more than MaxAutoTargetingUpdatesPerFrame components are updated per frame,
+	each no more often than its interval.
+	*/
+	void RegisterAutoTargetingComponent(UTargetSelectionComponent* Component);
+
+	/*Remove the component from the auto-targeting updates.*/
+	void UnregisterAutoTargetingComponent(UTargetSelectionComponent* Component);
+
+	/*Set how many components can update the auto-targeting in one frame.*/
+	UFUNCTION(BlueprintCallable, Category = "TargetSelectionSubsystem")
+		void SetMaxAutoTargetingUpdatesPerFrame(int32 MaxUpdates);
+
+	/*Is the actor registered?*/
+	bool IsTargetableActorRegistered(const AActor* TargetableActor) const { return RegisteredActorsIndices.Contains(TargetableActor); };
+
+	/*Get the location of the registered actor read at the beginning of the frame. Returns nullptr if the actor is not registered.*/
+	const FVector* FindTargetableActorLocation(const AActor* TargetableActor) const { return TargetableActorsGrid.FindLocation(TargetableActor); };
+
+	// USubsystem
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// UObject
+	virtual UWorld* GetWorld() const override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+
+private:
+
+	/*Registered actor.*/
+	struct FRegisteredActor
+	{
+		/*To find out that the actor is destroyed.*/
+		TWeakObjectPtr<AActor> Actor;
+
+		/*Key of the actor in the grid. Not dereferenced.*/
+		AActor* Key;
+	};
+
+	/*Request of a client to observe an actor.*/
+	struct FSwitchRequest
+	{
+		TWeakObjectPtr<UTargetSelectionComponent> Component;
+		TWeakObjectPtr<AActor> RequestedActor;
+	};
+
+	/*The requests a connection can still send.*/
+	struct FSwitchRequestBudget
+	{
+		TWeakObjectPtr<UNetConnection> Connection;
+		float NumRequests;
+		float LastTime;
+	};
+
+	/*Read the locations of the registered actors into the grid and forget the destroyed ones.*/
+	void UpdateTargetableActors();
+
+	/*Check the queued requests by the locations of this frame and apply the valid ones.*/
+	void ProcessSwitchRequests();
+
+	/*Update the components whose auto-targeting interval has passed, continuing from the component after the last updated one.*/
+	void UpdateAutoTargetingComponents();
+
+	/*Take one request from the budget of the connection. Returns false if the budget is spent.*/
+	bool ConsumeSwitchRequestBudget(UNetConnection* Connection);
+
+	/*Forget everything of the world that is cleaned up.*/
+	void OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
+
+	/*Remove all registered actors, requests and components.*/
+	void EmptyRegistry();
+
+	/*Remove the registered actor by index.*/
+	void RemoveRegisteredActorAt(int32 Index);
+
+	/*The registered actors, contiguous for the update.*/
+	TArray<FRegisteredActor> RegisteredActors;
+
+	/*Indices of the registered actors in RegisteredActors.*/
+	TMap<const AActor*, int32> RegisteredActorsIndices;
+
+	/*Grid of the registered actors.*/
+	FTargetSelectionSpatialGrid TargetableActorsGrid;
+
+	/*The requests to switch the actor queued in this frame.*/
+	TArray<FSwitchRequest> PendingSwitchRequests;
+
+	/*Buffer of ProcessSwitchRequests(). The components whose last request is checked.*/
+	TSet<const UTargetSelectionComponent*> ProcessedSwitchComponents;
+
+	/*Budgets of the requests by the connections.*/
+	TMap<const UNetConnection*, FSwitchRequestBudget> SwitchRequestBudgets;
+
+	/*Number of the requests per second one connection can send on average.*/
+	float SwitchRequestsPerSecond = 10.f;
+
+	/*Number of the requests one connection can send at once.*/
+	int32 MaxSwitchRequestBurst = 5;
+
+	/*The components with the auto-targeting on.*/
+	TArray<TWeakObjectPtr<UTargetSelectionComponent>> AutoTargetingComponents;
+
+	/*Index of the component that is checked first on the next frame.*/
+	int32 NextAutoTargetingIndex = 0;
+
+	/*Number of the components that can update the auto-targeting in one frame.*/
+	int32 MaxAutoTargetingUpdatesPerFrame = 4;
+};
@@ -0,0 +1,192 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+/*
+Microbenchmark of TargetSelectionCore on Google Benchmark. The argument of every case is the number of the candidates.
+Run: TargetSelectionCoreBenchmark --benchmark_filter=<regex> --benchmark_format=csv
+*/
+
+#include "TargetSelectionCore.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	std::vector<float> MakeRandomKeys(int32_t Num)
+	{
+		std::mt19937 Random(42);
+		std::uniform_real_distribution<float> Distribution(0.f, 1.0e8f);
+		std::vector<float> Keys(Num);
+		for (float& Key : Keys)
+		{
+			Key = Distribution(Random);
+		}
+		return Keys;
+	}
+
+	/*The sorted keys with a few neighbours swapped, as after a frame of small movements.*/
+	std::vector<float> MakeAlmostSortedKeys(int32_t Num)
+	{
+		std::vector<float> Keys = MakeRandomKeys(Num);
+		std::sort(Keys.begin(), Keys.end());
+		for (int32_t Index = 0; Index + 1 < Num; Index += 64)
+		{
+			std::swap(Keys[Index], Keys[Index + 1]);
+		}
+		return Keys;
+	}
+
+	struct FBenchmarkPosition
+	{
+		float X = 0.f;
+	};
+
+	using FBenchmarkCore = TTargetSelectionCore<int32_t, FBenchmarkPosition>;
+
+	float GetDistanceSquared(const FBenchmarkPosition& A, const FBenchmarkPosition& B)
+	{
+		return (A.X - B.X) * (A.X - B.X);
+	}
+
+	/*The candidates at the random distances from the owner at 0, sorted and the first one observed.*/
+	void FillCore(FBenchmarkCore& Core, const std::vector<float>& Keys)
+	{
+		for (int32_t Index = 0; Index != int32_t(Keys.size()); Index++)
+		{
+			Core.Add(Index + 1, { Keys[Index] });
+		}
+		std::vector<float> SquaredKeys(Keys.size());
+		for (int32_t Index = 0; Index != Core.Num(); Index++)
+		{
+			SquaredKeys[Index] = GetDistanceSquared(Core.GetPosition(Index), FBenchmarkPosition());
+		}
+		Core.Sort(SquaredKeys.data(), FBenchmarkPosition(), 0, 0.f, GetDistanceSquared);
+		Core.SetObservedIndex(0);
+	}
+
+	void SortIndicesByKeys_Random(benchmark::State& State)
+	{
+		const int32_t Num = int32_t(State.range(0));
+		const std::vector<float> Keys = MakeRandomKeys(Num);
+		std::vector<int32_t> Indices(Num);
+		for (auto _ : State)
+		{
+			TargetSelectionCore::SortIndicesByKeys(Keys.data(), Num, Indices.data());
+			benchmark::DoNotOptimize(Indices.data());
+		}
+	}
+
+	void SortIndicesByKeys_AlmostSorted(benchmark::State& State)
+	{
+		const int32_t Num = int32_t(State.range(0));
+		const std::vector<float> Keys = MakeAlmostSortedKeys(Num);
+		std::vector<int32_t> Indices(Num);
+		for (auto _ : State)
+		{
+			TargetSelectionCore::SortIndicesByKeys(Keys.data(), Num, Indices.data());
+			benchmark::DoNotOptimize(Indices.data());
+		}
+	}
+
+	void InsertionSortIndicesByKeys_AlmostSorted(benchmark::State& State)
+	{
+		const int32_t Num = int32_t(State.range(0));
+		const std::vector<float> Keys = MakeAlmostSortedKeys(Num);
+		std::vector<int32_t> Indices(Num);
+		for (auto _ : State)
+		{
+			benchmark::DoNotOptimize(TargetSelectionCore::InsertionSortIndicesByKeys(Keys.data(), Num, Indices.data()));
+		}
+	}
+
+	/*The second argument is the number of the nearest candidates to order.*/
+	void SelectNearestIndices(benchmark::State& State)
+	{
+		const int32_t Num = int32_t(State.range(0));
+		const int32_t NumToOrder = int32_t(State.range(1));
+		const std::vector<float> Keys = MakeRandomKeys(Num);
+		std::vector<int32_t> Indices(Num);
+		std::unique_ptr<bool[]> SelectedFlags(new bool[Num]);
+		for (auto _ : State)
+		{
+			TargetSelectionCore::SelectNearestIndices(Keys.data(), Num, NumToOrder, Indices.data(), SelectedFlags.get());
+			benchmark::DoNotOptimize(Indices.data());
+		}
+	}
+
+	void FindInsertIndex(benchmark::State& State)
+	{
+		const int32_t Num = int32_t(State.range(0));
+		std::vector<float> SortedKeys = MakeRandomKeys(Num);
+		std::sort(SortedKeys.begin(), SortedKeys.end());
+		const std::vector<float> Keys = MakeRandomKeys(Num);
+		int32_t Index = 0;
+		for (auto _ : State)
+		{
+			benchmark::DoNotOptimize(TargetSelectionCore::FindInsertIndex(SortedKeys.data(), Num, Keys[Index]));
+			Index = Index + 1 < Num ? Index + 1 : 0;
+		}
+	}
+
+	void Core_CycleObserved(benchmark::State& State)
+	{
+		FBenchmarkCore Core;
+		FillCore(Core, MakeRandomKeys(int32_t(State.range(0))));
+		for (auto _ : State)
+		{
+			benchmark::DoNotOptimize(Core.CycleObserved(0));
+		}
+	}
+
+	/*The observed candidate is removed, the next one is observed and the removed one is inserted back at its place.*/
+	void Core_RemoveObservedAndInsert(benchmark::State& State)
+	{
+		FBenchmarkCore Core;
+		FillCore(Core, MakeRandomKeys(int32_t(State.range(0))));
+		for (auto _ : State)
+		{
+			const int32_t Handle = Core.GetObserved();
+			const FBenchmarkPosition Position = Core.GetPosition(Core.GetObservedIndex());
+			Core.RemoveAt(Core.GetObservedIndex());
+			Core.ObserveAfterRemoval(false);
+			Core.InsertByKey(Handle, Position, GetDistanceSquared(Position, FBenchmarkPosition()));
+			benchmark::DoNotOptimize(Core.Find(Handle));
+		}
+	}
+
+	/*The owner walks, so the order changes a little between the sorts.*/
+	void Core_Sort_OwnerWalks(benchmark::State& State)
+	{
+		FBenchmarkCore Core;
+		const std::vector<float> Positions = MakeRandomKeys(int32_t(State.range(0)));
+		FillCore(Core, Positions);
+		std::vector<float> Keys(Positions.size());
+		float OwnerX = 0.f;
+		for (auto _ : State)
+		{
+			OwnerX += 10.f;
+			const FBenchmarkPosition OwnerPosition{ OwnerX };
+			for (int32_t Index = 0; Index != Core.Num(); Index++)
+			{
+				Keys[Index] = GetDistanceSquared(Core.GetPosition(Index), OwnerPosition);
+			}
+			benchmark::DoNotOptimize(Core.Sort(Keys.data(), OwnerPosition, 0, 0.f, GetDistanceSquared));
+		}
+	}
+}
+
+BENCHMARK(SortIndicesByKeys_Random)->RangeMultiplier(10)->Range(100, 100000);
+BENCHMARK(SortIndicesByKeys_AlmostSorted)->RangeMultiplier(10)->Range(100, 100000);
+BENCHMARK(InsertionSortIndicesByKeys_AlmostSorted)->RangeMultiplier(10)->Range(100, 100000);
+BENCHMARK(SelectNearestIndices)->ArgsProduct({ { 1000, 10000, 100000 }, { 1, 8, 64 } });
+BENCHMARK(FindInsertIndex)->RangeMultiplier(10)->Range(100, 100000);
+BENCHMARK(Core_CycleObserved)->RangeMultiplier(10)->Range(100, 100000);
+BENCHMARK(Core_RemoveObservedAndInsert)->RangeMultiplier(10)->Range(100, 10000);
+BENCHMARK(Core_Sort_OwnerWalks)->RangeMultiplier(10)->Range(100, 100000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,460 @@
+// Copyright 2019 Anatoli Kucharau. All Rights Reserved.
+
+/*
+Unit tests of TargetSelectionCore and TTargetSelectionCore. Build with the CMakeLists.txt of the plugin root and run by ctest.
+Every test compares the rules with a plain reference implementation on fixed and random inputs.
+*/
+
+#include "TargetSelectionCore.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+	int NumFailedChecks = 0;
+
+	void Check(bool bIsPassed, const char* Expression, const char* File, int Line)
+	{
+		if (!bIsPassed)
+		{
+			std::printf("%s:%d: check failed: %s\n", File, Line, Expression);
+			++NumFailedChecks;
+		}
+	}
+
+#define TS_CHECK(Expression) Check((Expression), #Expression, __FILE__, __LINE__)
+
+	/*The order the rules must give: by the keys, equal keys in the order of the array.*/
+	std::vector<int32_t> GetReferenceOrder(const std::vector<float>& Keys)
+	{
+		std::vector<int32_t> Indices(Keys.size());
+		std::iota(Indices.begin(), Indices.end(), 0);
+		std::stable_sort(Indices.begin(), Indices.end(), [&Keys](int32_t A, int32_t B)
+		{
+			return Keys[A] < Keys[B];
+		});
+		return Indices;
+	}
+
+	/*Random keys with many equal ones, so the order of the equal keys is checked too.*/
+	std::vector<float> MakeRandomKeys(std::mt19937& Random, int32_t Num)
+	{
+		std::uniform_int_distribution<int> Distribution(0, Num / 2 + 1);
+		std::vector<float> Keys(Num);
+		for (float& Key : Keys)
+		{
+			Key = float(Distribution(Random)) * 100.f;
+		}
+		return Keys;
+	}
+
+	void TestIsNearer()
+	{
+		const float Keys[] = { 5.f, 1.f, 5.f };
+		TS_CHECK(TargetSelectionCore::IsNearer(Keys, 1, 0));
+		TS_CHECK(!TargetSelectionCore::IsNearer(Keys, 0, 1));
+		TS_CHECK(TargetSelectionCore::IsNearer(Keys, 0, 2));
+		TS_CHECK(!TargetSelectionCore::IsNearer(Keys, 2, 0));
+		TS_CHECK(!TargetSelectionCore::IsNearer(Keys, 0, 0));
+	}
+
+	void TestSortIndicesByKeys()
+	{
+		const float Keys[] = { 30.f, 10.f, 20.f, 10.f };
+		int32_t Indices[4];
+		TargetSelectionCore::SortIndicesByKeys(Keys, 4, Indices);
+		TS_CHECK(Indices[0] == 1 && Indices[1] == 3 && Indices[2] == 2 && Indices[3] == 0);
+
+		/*Nothing to sort.*/
+		TargetSelectionCore::SortIndicesByKeys(Keys, 0, Indices);
+
+		std::mt19937 Random(1);
+		for (int32_t Num = 1; Num <= 200; Num += 7)
+		{
+			const std::vector<float> RandomKeys = MakeRandomKeys(Random, Num);
+			std::vector<int32_t> Result(Num);
+			TargetSelectionCore::SortIndicesByKeys(RandomKeys.data(), Num, Result.data());
+			TS_CHECK(Result == GetReferenceOrder(RandomKeys));
+		}
+	}
+
+	void TestInsertionSortIndicesByKeys()
+	{
+		/*Already in order.*/
+		const float SortedKeys[] = { 1.f, 2.f, 2.f, 3.f };
+		int32_t Indices[4];
+		TS_CHECK(TargetSelectionCore::InsertionSortIndicesByKeys(SortedKeys, 4, Indices) == 4);
+		TS_CHECK(Indices[0] == 0 && Indices[1] == 1 && Indices[2] == 2 && Indices[3] == 3);
+
+		/*One element moved ahead, the first moved position is reported.*/
+		const float AlmostSortedKeys[] = { 1.f, 2.f, 4.f, 3.f };
+		TS_CHECK(TargetSelectionCore::InsertionSortIndicesByKeys(AlmostSortedKeys, 4, Indices) == 2);
+		TS_CHECK(Indices[0] == 0 && Indices[1] == 1 && Indices[2] == 3 && Indices[3] == 2);
+
+		TS_CHECK(TargetSelectionCore::InsertionSortIndicesByKeys(SortedKeys, 0, Indices) == 0);
+
+		/*The same result as the full sort.*/
+		std::mt19937 Random(2);
+		for (int32_t Num = 1; Num <= 200; Num += 7)
+		{
+			const std::vector<float> RandomKeys = MakeRandomKeys(Random, Num);
+			const std::vector<int32_t> Reference = GetReferenceOrder(RandomKeys);
+			std::vector<int32_t> Result(Num);
+			const int32_t FirstMovedIndex = TargetSelectionCore::InsertionSortIndicesByKeys(RandomKeys.data(), Num, Result.data());
+			TS_CHECK(Result == Reference);
+
+			int32_t ExpectedFirstMovedIndex = Num;
+			for (int32_t Position = 0; Position != Num; Position++)
+			{
+				if (Reference[Position] != Position)
+				{
+					ExpectedFirstMovedIndex = Position;
+					break;
+				}
+			}
+			TS_CHECK(FirstMovedIndex == ExpectedFirstMovedIndex);
+		}
+	}
+
+	void TestSelectNearestIndices()
+	{
+		const float Keys[] = { 50.f, 10.f, 40.f, 10.f, 20.f };
+		int32_t Indices[5];
+		bool SelectedFlags[5];
+		TargetSelectionCore::SelectNearestIndices(Keys, 5, 2, Indices, SelectedFlags);
+		/*The two nearest in order, then the rest in the order of the array.*/
+		TS_CHECK(Indices[0] == 1 && Indices[1] == 3);
+		TS_CHECK(Indices[2] == 0 && Indices[3] == 2 && Indices[4] == 4);
+
+		/*Nothing to order keeps the array.*/
+		TargetSelectionCore::SelectNearestIndices(Keys, 5, 0, Indices, SelectedFlags);
+		for (int32_t Index = 0; Index != 5; Index++)
+		{
+			TS_CHECK(Indices[Index] == Index);
+		}
+
+		std::mt19937 Random(3);
+		for (int32_t Num = 1; Num <= 200; Num += 7)
+		{
+			const std::vector<float> RandomKeys = MakeRandomKeys(Random, Num);
+			const std::vector<int32_t> Reference = GetReferenceOrder(RandomKeys);
+			for (int32_t NumToOrder : { 1, 3, Num / 2, Num, Num + 5 })
+			{
+				std::vector<int32_t> Result(Num);
+				std::unique_ptr<bool[]> Flags(new bool[Num]);
+				TargetSelectionCore::SelectNearestIndices(RandomKeys.data(), Num, NumToOrder, Result.data(), Flags.get());
+
+				const int32_t NumOrdered = std::min(NumToOrder, Num);
+				TS_CHECK(std::equal(Result.begin(), Result.begin() + NumOrdered, Reference.begin()));
+
+				/*The rest keep the order of the array.*/
+				TS_CHECK(std::is_sorted(Result.begin() + NumOrdered, Result.end()));
+
+				std::vector<int32_t> SortedResult = Result;
+				std::sort(SortedResult.begin(), SortedResult.end());
+				std::vector<int32_t> AllIndices(Num);
+				std::iota(AllIndices.begin(), AllIndices.end(), 0);
+				TS_CHECK(SortedResult == AllIndices);
+			}
+		}
+	}
+
+	void TestFindInsertIndex()
+	{
+		const float SortedKeys[] = { 10.f, 20.f, 20.f, 30.f };
+		TS_CHECK(TargetSelectionCore::FindInsertIndex(SortedKeys, 4, 5.f) == 0);
+		TS_CHECK(TargetSelectionCore::FindInsertIndex(SortedKeys, 4, 10.f) == 1);
+		/*After the equal keys.*/
+		TS_CHECK(TargetSelectionCore::FindInsertIndex(SortedKeys, 4, 20.f) == 3);
+		TS_CHECK(TargetSelectionCore::FindInsertIndex(SortedKeys, 4, 25.f) == 3);
+		TS_CHECK(TargetSelectionCore::FindInsertIndex(SortedKeys, 4, 40.f) == 4);
+		TS_CHECK(TargetSelectionCore::FindInsertIndex(SortedKeys, 0, 40.f) == 0);
+	}
+
+	void TestGetNextCycleIndex()
+	{
+		TS_CHECK(TargetSelectionCore::GetNextCycleIndex(0, 3) == 1);
+		TS_CHECK(TargetSelectionCore::GetNextCycleIndex(1, 3) == 2);
+		TS_CHECK(TargetSelectionCore::GetNextCycleIndex(2, 3) == 0);
+		TS_CHECK(TargetSelectionCore::GetNextCycleIndex(0, 1) == 0);
+		/*The index outside the cycled range goes back to the first element.*/
+		TS_CHECK(TargetSelectionCore::GetNextCycleIndex(5, 3) == 0);
+	}
+
+	void TestGetIndexAfterRemoval()
+	{
+		TS_CHECK(TargetSelectionCore::GetIndexAfterRemoval(3, 0, 5, true) == 0);
+		/*The element that followed the removed one takes its index.*/
+		TS_CHECK(TargetSelectionCore::GetIndexAfterRemoval(3, 0, 5, false) == 3);
+		TS_CHECK(TargetSelectionCore::GetIndexAfterRemoval(3, 2, 5, false) == 1);
+		/*The removed element was the last one.*/
+		TS_CHECK(TargetSelectionCore::GetIndexAfterRemoval(4, 0, 4, false) == 0);
+		TS_CHECK(TargetSelectionCore::GetIndexAfterRemoval(0, 0, 1, false) == 0);
+	}
+
+	/*The candidates on a line, the handles are 1, 2... 0 is no candidate.*/
+	struct FTestPosition
+	{
+		float X = 0.f;
+	};
+
+	using FTestCore = TTargetSelectionCore<int32_t, FTestPosition>;
+
+	float GetDistanceSquared(const FTestPosition& A, const FTestPosition& B)
+	{
+		return (A.X - B.X) * (A.X - B.X);
+	}
+
+	/*Sort by the distances from the owner at OwnerX to the current positions.*/
+	FTestCore::ESortResult SortCore(FTestCore& Core, float OwnerX, int32_t NumNearestToOrder = 0, float MovementThreshold = 0.f)
+	{
+		const FTestPosition OwnerPosition{ OwnerX };
+		std::vector<float> Keys(Core.Num());
+		for (int32_t Index = 0; Index != Core.Num(); Index++)
+		{
+			Keys[Index] = GetDistanceSquared(Core.GetPosition(Index), OwnerPosition);
+		}
+		return Core.Sort(Keys.data(), OwnerPosition, NumNearestToOrder, MovementThreshold, GetDistanceSquared);
+	}
+
+	std::vector<int32_t> GetHandles(const FTestCore& Core)
+	{
+		return std::vector<int32_t>(Core.GetHandles().begin(), Core.GetHandles().end());
+	}
+
+	/*The observed handle is always at the observed index.*/
+	bool IsObservedIndexValid(const FTestCore& Core)
+	{
+		if (!Core.HasObserved())
+		{
+			return Core.GetObserved() == 0;
+		}
+		return Core.IsValidIndex(Core.GetObservedIndex()) && Core.GetHandle(Core.GetObservedIndex()) == Core.GetObserved();
+	}
+
+	void TestCoreAddFindCycle()
+	{
+		FTestCore Core;
+		TS_CHECK(Core.Num() == 0 && !Core.HasObserved());
+		TS_CHECK(Core.Find(1) == TargetSelectionCore::NoIndex);
+
+		Core.Add(1, { 30.f });
+		Core.Add(2, { 10.f });
+		Core.Add(3, { 20.f });
+		/*The duplicate is kept, the first copy is found.*/
+		Core.Add(2, { 10.f });
+		TS_CHECK(Core.Num() == 4 && Core.GetNumUnique() == 3);
+		TS_CHECK(Core.Find(2) == 1 && Core.Find(3) == 2);
+		TS_CHECK(!Core.IsOrderValid());
+
+		Core.SetObservedIndex(0);
+		TS_CHECK(Core.GetObserved() == 1);
+		TS_CHECK(Core.CycleObserved(0) == 1 && Core.GetObserved() == 2);
+		TS_CHECK(Core.CycleObserved(0) == 2);
+		TS_CHECK(Core.CycleObserved(0) == 3);
+		TS_CHECK(Core.CycleObserved(0) == 0 && Core.GetObserved() == 1);
+
+		/*Only the nearest 2 are cycled through.*/
+		TS_CHECK(Core.CycleObserved(2) == 1);
+		TS_CHECK(Core.CycleObserved(2) == 0);
+
+		Core.Reset();
+		TS_CHECK(Core.Num() == 0 && !Core.HasObserved() && Core.Find(1) == TargetSelectionCore::NoIndex);
+	}
+
+	void TestCoreSortFollowsObserved()
+	{
+		FTestCore Core;
+		Core.Add(1, { 30.f });
+		Core.Add(2, { 10.f });
+		Core.Add(3, { 20.f });
+		Core.SetObservedIndex(0);
+
+		TS_CHECK(SortCore(Core, 0.f) == FTestCore::ESortResult::Sorted);
+		TS_CHECK(GetHandles(Core) == std::vector<int32_t>({ 2, 3, 1 }));
+		TS_CHECK(Core.GetObserved() == 1 && Core.GetObservedIndex() == 2);
+		TS_CHECK(Core.Find(1) == 2 && Core.Find(2) == 0 && Core.Find(3) == 1);
+		TS_CHECK(Core.IsOrderValid() && Core.GetNumOrdered() == 3);
+
+		/*Nothing moved, the sort is skipped.*/
+		TS_CHECK(SortCore(Core, 0.f, 0, 1.f) == FTestCore::ESortResult::Skipped);
+
+		/*One candidate moved, it is moved to its place by insertion.*/
+		Core.UpdatePositions([](int32_t Handle) { return FTestPosition{ Handle == 1 ? 5.f : Handle == 2 ? 10.f : 20.f }; });
+		TS_CHECK(SortCore(Core, 0.f, 0, 1.f) == FTestCore::ESortResult::Sorted);
+		TS_CHECK(GetHandles(Core) == std::vector<int32_t>({ 1, 2, 3 }));
+		TS_CHECK(Core.GetObservedIndex() == 0 && IsObservedIndexValid(Core));
+
+		/*Only the nearest one is ordered.*/
+		TS_CHECK(SortCore(Core, 25.f, 1) == FTestCore::ESortResult::Sorted);
+		TS_CHECK(Core.GetHandle(0) == 3 && Core.GetNumOrdered() == 1 && IsObservedIndexValid(Core));
+
+		FTestCore SingleCore;
+		SingleCore.Add(1, { 5.f });
+		TS_CHECK(SortCore(SingleCore, 0.f) == FTestCore::ESortResult::Cached);
+		TS_CHECK(SingleCore.IsOrderValid());
+	}
+
+	void TestCoreInsertByKey()
+	{
+		FTestCore Core;
+		Core.Add(1, { 10.f });
+		Core.Add(2, { 30.f });
+		Core.SetObservedIndex(1);
+		SortCore(Core, 0.f);
+
+		/*Inserted before the observed candidate, its index follows it.*/
+		TS_CHECK(Core.InsertByKey(3, { 20.f }, 400.f) == 1);
+		TS_CHECK(GetHandles(Core) == std::vector<int32_t>({ 1, 3, 2 }));
+		TS_CHECK(Core.GetObservedIndex() == 2 && IsObservedIndexValid(Core));
+		TS_CHECK(Core.Find(2) == 2 && Core.Find(3) == 1);
+
+		/*Farther than all, goes to the end.*/
+		TS_CHECK(Core.InsertByKey(4, { 40.f }, 1600.f) == 3);
+		TS_CHECK(Core.GetNumOrdered() == 4 && Core.IsOrderValid());
+
+		/*The same order as a full sort.*/
+		const std::vector<int32_t> Inserted = GetHandles(Core);
+		SortCore(Core, 0.f);
+		TS_CHECK(GetHandles(Core) == Inserted);
+	}
+
+	void TestCoreRemove()
+	{
+		FTestCore Core;
+		for (int32_t Handle = 1; Handle <= 5; Handle++)
+		{
+			Core.Add(Handle, { float(Handle) });
+		}
+		Core.SetObservedIndex(2);
+
+		TS_CHECK(Core.GetRemoval(9) == FTestCore::ERemoval::NotFound);
+		TS_CHECK(Core.GetRemoval(1) == FTestCore::ERemoval::Other);
+		TS_CHECK(Core.GetRemoval(3) == FTestCore::ERemoval::Observed);
+
+		/*Another candidate before the observed one.*/
+		Core.RemoveAt(Core.Find(1));
+		TS_CHECK(Core.GetObserved() == 3 && Core.GetObservedIndex() == 1);
+		TS_CHECK(Core.Find(4) == 2);
+
+		/*The observed one, the next one is observed after it.*/
+		Core.RemoveAt(Core.GetObservedIndex());
+		TS_CHECK(!Core.HasObserved() && Core.Num() == 3);
+		Core.ObserveAfterRemoval(false);
+		TS_CHECK(Core.GetObserved() == 4 && IsObservedIndexValid(Core));
+
+		/*Several at once, the observed one among them.*/
+		Core.Add(6, { 6.f });
+		Core.Add(7, { 7.f });
+		TS_CHECK(Core.RemoveAll([](int32_t Handle) { return Handle == 2 || Handle == 4 || Handle == 7; }) == 3);
+		TS_CHECK(GetHandles(Core) == std::vector<int32_t>({ 5, 6 }));
+		TS_CHECK(!Core.HasObserved());
+		Core.ObserveAfterRemoval(false);
+		TS_CHECK(Core.GetObserved() == 5 && Core.GetObservedIndex() == 0);
+		TS_CHECK(Core.Find(6) == 1 && Core.Find(4) == TargetSelectionCore::NoIndex);
+
+		/*The observed one stays, its index moves back.*/
+		Core.SetObservedIndex(1);
+		TS_CHECK(Core.RemoveAll([](int32_t Handle) { return Handle == 5; }) == 1);
+		TS_CHECK(Core.GetObserved() == 6 && Core.GetObservedIndex() == 0);
+		TS_CHECK(Core.GetRemoval(6) == FTestCore::ERemoval::Last);
+
+		/*The order of the last sort is kept by the removal.*/
+		Core.Add(8, { 8.f });
+		Core.Add(9, { 9.f });
+		SortCore(Core, 0.f);
+		Core.RemoveAt(1);
+		TS_CHECK(Core.IsOrderValid() && Core.GetNumOrdered() == 2);
+		TS_CHECK(SortCore(Core, 0.f, 0, 1.f) == FTestCore::ESortResult::Skipped);
+	}
+
+	/*Random operations against a plain vector, the observed index must always point at the observed handle.*/
+	void TestCoreRandomOperations()
+	{
+		std::mt19937 Random(4);
+		FTestCore Core;
+		std::vector<int32_t> Reference;
+		for (int32_t Step = 0; Step != 5000; Step++)
+		{
+			const int32_t Operation = Reference.empty() ? 0 : std::uniform_int_distribution<int32_t>(0, 5)(Random);
+			const int32_t Handle = std::uniform_int_distribution<int32_t>(1, 40)(Random);
+			switch (Operation)
+			{
+			case 0:
+				Core.Add(Handle, { float(Handle) });
+				Reference.push_back(Handle);
+				break;
+			case 1:
+				Core.CycleObserved(std::uniform_int_distribution<int32_t>(0, 3)(Random));
+				break;
+			case 2:
+			{
+				const int32_t Index = std::uniform_int_distribution<int32_t>(0, int32_t(Reference.size()) - 1)(Random);
+				Core.RemoveAt(Index);
+				Reference.erase(Reference.begin() + Index);
+				if (!Core.HasObserved() && !Reference.empty())
+				{
+					Core.ObserveAfterRemoval(Step % 2 == 0);
+				}
+				break;
+			}
+			case 3:
+				Core.RemoveAll([Handle](int32_t Candidate) { return Candidate == Handle; });
+				Reference.erase(std::remove(Reference.begin(), Reference.end(), Handle), Reference.end());
+				if (!Core.HasObserved() && !Reference.empty())
+				{
+					Core.ObserveAfterRemoval(false);
+				}
+				break;
+			case 4:
+			{
+				const float OwnerX = float(Handle);
+				SortCore(Core, OwnerX, Step % 3);
+				Reference = GetHandles(Core);
+				break;
+			}
+			default:
+				if (Core.IsOrderValid())
+				{
+					Core.InsertByKey(Handle, { float(Handle) }, 0.f);
+					Reference = GetHandles(Core);
+				}
+				break;
+			}
+
+			TS_CHECK(GetHandles(Core) == Reference);
+			TS_CHECK(IsObservedIndexValid(Core));
+			const auto Found = std::find(Reference.begin(), Reference.end(), Handle);
+			TS_CHECK(Core.Find(Handle) == (Found != Reference.end() ? int32_t(Found - Reference.begin()) : TargetSelectionCore::NoIndex));
+		}
+	}
+}
+
+int main()
+{
+	TestIsNearer();
+	TestSortIndicesByKeys();
+	TestInsertionSortIndicesByKeys();
+	TestSelectNearestIndices();
+	TestFindInsertIndex();
+	TestGetNextCycleIndex();
+	TestGetIndexAfterRemoval();
+	TestCoreAddFindCycle();
+	TestCoreSortFollowsObserved();
+	TestCoreInsertByKey();
+	TestCoreRemove();
+	TestCoreRandomOperations();
+
+	if (NumFailedChecks > 0)
+	{
+		std::printf("%d checks failed.\n", NumFailedChecks);
+		return 1;
+	}
+	std::printf("All checks passed.\n");
+	return 0;
+}